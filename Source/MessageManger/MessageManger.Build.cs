@@ -8,6 +8,8 @@ public class MessageManger : ModuleRules
 	public MessageManger(ReadOnlyTargetRules Target) : base(Target)
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+		// FMessageChannel使用C++20协程
+		CppStandard = CppStandardVersion.Cpp20;
 
         PublicIncludePaths.AddRange(
 			new string[] {
@@ -31,6 +33,7 @@ public class MessageManger : ModuleRules
 				"Core",
 				"Sockets",
 				"Json",
+				"JsonUtilities",
 				"Networking",
                 "ProtobufLibrary",
 				"Engine",
@@ -51,6 +54,19 @@ public class MessageManger : ModuleRules
 			);
 		
 		
+		// Linux发送路径需要FSocketBSD的原生句柄来调用sendmsg / MSG_ZEROCOPY，接收路径用它读取SO_TIMESTAMPNS
+		if (Target.Platform == UnrealTargetPlatform.Linux)
+		{
+			PrivateIncludePaths.Add(Path.Combine(EngineDirectory, "Source/Runtime/Sockets/Private"));
+			PrivateDefinitions.Add("WITH_SOCKET_GATHER_SEND=1");
+			PrivateDefinitions.Add("WITH_SOCKET_RECV_TIMESTAMPS=1");
+		}
+		else
+		{
+			PrivateDefinitions.Add("WITH_SOCKET_GATHER_SEND=0");
+			PrivateDefinitions.Add("WITH_SOCKET_RECV_TIMESTAMPS=0");
+		}
+
 		DynamicallyLoadedModuleNames.AddRange(
 			new string[]
 			{
@@ -0,0 +1,71 @@
+﻿#include "DecodePipeline.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+#include "Tasks/Task.h"
+
+FOrderedDecodePipeline::FOrderedDecodePipeline(FMessageInbox& InInbox)
+    : Inbox(InInbox)
+    , NextSequence(0)
+    , NextToDeliver(0)
+    , InFlight(0)
+{
+}
+
+FOrderedDecodePipeline::~FOrderedDecodePipeline()
+{
+    Flush();
+}
+
+void FOrderedDecodePipeline::Submit(FInboxEntry&& Entry, bool bDecodeInParallel)
+{
+    const uint64 Sequence = NextSequence++;
+    InFlight.fetch_add(1, std::memory_order_relaxed);
+
+    if (!bDecodeInParallel || !DecodeFunction)
+    {
+        Complete(Sequence, MoveTemp(Entry));
+        return;
+    }
+
+    UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, Sequence, Entry = MoveTemp(Entry)]() mutable
+    {
+        DecodeFunction(Entry);
+        Complete(Sequence, MoveTemp(Entry));
+    });
+}
+
+void FOrderedDecodePipeline::Complete(uint64 Sequence, FInboxEntry&& Entry)
+{
+    int32 Delivered = 0;
+    {
+        FScopeLock Lock(&ReorderLock);
+        if (Sequence != NextToDeliver)
+        {
+            // 前面还有消息没有解码完，先放入重排缓冲区
+            Pending.Add(Sequence, MoveTemp(Entry));
+            return;
+        }
+
+        Inbox.Enqueue(MoveTemp(Entry));
+        ++NextToDeliver;
+        ++Delivered;
+
+        FInboxEntry Next;
+        while (Pending.Num() > 0 && Pending.RemoveAndCopyValue(NextToDeliver, Next))
+        {
+            Inbox.Enqueue(MoveTemp(Next));
+            ++NextToDeliver;
+            ++Delivered;
+        }
+    }
+    InFlight.fetch_sub(Delivered, std::memory_order_release);
+}
+
+void FOrderedDecodePipeline::Flush()
+{
+    // 只在断开连接时调用，解码任务很短，不需要事件
+    while (InFlight.load(std::memory_order_acquire) > 0)
+    {
+        FPlatformProcess::SleepNoStats(0.0001f);
+    }
+}
@@ -0,0 +1,173 @@
+﻿#include "FrameDecoder.h"
+#include "Sockets.h"
+
+#ifndef WITH_SOCKET_RECV_TIMESTAMPS
+#define WITH_SOCKET_RECV_TIMESTAMPS 0
+#endif
+
+#if WITH_SOCKET_RECV_TIMESTAMPS
+#include "BSDSockets/SocketsBSD.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <time.h>
+#endif
+
+FFrameDecoder::FFrameDecoder(int32 InCapacity, int32 InMaxMessageSize)
+    : MaxMessageSize((uint32)FMath::Max(1, InMaxMessageSize))
+    , ReadPos(0)
+    , WritePos(0)
+{
+    const int32 MinCapacity = MessageProtocol::HeaderSize + MessageProtocol::MaxChunkSize;
+    const uint32 Capacity = FMath::RoundUpToPowerOfTwo((uint32)FMath::Max(InCapacity, MinCapacity));
+    Ring.SetNumUninitialized(Capacity);
+    Scratch.SetNumUninitialized(MinCapacity);
+    Mask = Capacity - 1;
+}
+
+FFrameDecoder::EReadResult FFrameDecoder::ReadFromSocket(FSocket& Socket, int32& OutBytesRead)
+{
+    OutBytesRead = 0;
+    const uint64 Capacity = Mask + 1;
+
+    for (;;)
+    {
+        const uint64 FreeBytes = Capacity - (WritePos - ReadPos);
+        if (FreeBytes == 0)
+        {
+            return EReadResult::BufferFull;
+        }
+
+        // 只能写入到缓冲区末尾的连续空间
+        const uint64 WriteIndex = WritePos & Mask;
+        const int32 ContiguousBytes = (int32)FMath::Min(FreeBytes, Capacity - WriteIndex);
+
+        int32 BytesRead = 0;
+        if (!Socket.Recv(Ring.GetData() + WriteIndex, ContiguousBytes, BytesRead))
+        {
+            return EReadResult::Closed;
+        }
+
+        WritePos += BytesRead;
+        OutBytesRead += BytesRead;
+
+        // 读到的少于请求的，说明内核已无数据，省掉一次EWOULDBLOCK的系统调用
+        if (BytesRead < ContiguousBytes)
+        {
+            return EReadResult::Drained;
+        }
+    }
+}
+
+bool FFrameDecoder::ExtractFrames(TFunctionRef<void(const FChunkHeader& Header, const uint8* Payload, int32 PayloadSize)> FrameCallback)
+{
+    const uint64 Capacity = Mask + 1;
+
+    while (WritePos - ReadPos >= (uint64)MessageProtocol::HeaderSize)
+    {
+        FChunkHeader Header;
+        CopyOut(ReadPos, reinterpret_cast<uint8*>(&Header), MessageProtocol::HeaderSize);
+
+        const int32 PayloadSize = Header.GetPayloadSize(MaxMessageSize);
+        if (PayloadSize == INDEX_NONE)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Invalid chunk header (MessageId: %u, TotalLength: %u, ChunkIndex: %u, max message size: %u)"),
+                Header.MessageId, Header.TotalLength, Header.ChunkIndex, MaxMessageSize);
+            return false;
+        }
+
+        const int32 FrameSize = MessageProtocol::HeaderSize + PayloadSize;
+        if (WritePos - ReadPos < (uint64)FrameSize)
+        {
+            // 分片不完整，等待更多数据
+            break;
+        }
+
+        const uint64 PayloadPos = ReadPos + MessageProtocol::HeaderSize;
+        const uint64 PayloadIndex = PayloadPos & Mask;
+        if (PayloadIndex + PayloadSize <= Capacity)
+        {
+            // 负载连续，原地交给回调
+            FrameCallback(Header, Ring.GetData() + PayloadIndex, PayloadSize);
+        }
+        else
+        {
+            // 负载跨越缓冲区末尾，线性化到临时区
+            CopyOut(PayloadPos, Scratch.GetData(), PayloadSize);
+            FrameCallback(Header, Scratch.GetData(), PayloadSize);
+        }
+
+        ReadPos += FrameSize;
+    }
+
+    // 缓冲区为空时回到起点，让下次读取获得最大的连续空间
+    if (ReadPos == WritePos)
+    {
+        ReadPos = 0;
+        WritePos = 0;
+    }
+    return true;
+}
+
+void FFrameDecoder::CopyOut(uint64 Position, uint8* Dest, int32 Size) const
+{
+    const uint64 Capacity = Mask + 1;
+    const uint64 Index = Position & Mask;
+    const int32 FirstPart = (int32)FMath::Min<uint64>(Size, Capacity - Index);
+    FMemory::Memcpy(Dest, Ring.GetData() + Index, FirstPart);
+    if (FirstPart < Size)
+    {
+        FMemory::Memcpy(Dest + FirstPart, Ring.GetData(), Size - FirstPart);
+    }
+}
+
+bool FFrameDecoder::EnableArrivalTimestamps(FSocket& Socket)
+{
+#if WITH_SOCKET_RECV_TIMESTAMPS
+    const int NativeSocket = (int)static_cast<FSocketBSD&>(Socket).GetNativeSocket();
+    int Enable = 1;
+    if (setsockopt(NativeSocket, SOL_SOCKET, SO_TIMESTAMPNS, &Enable, sizeof(Enable)) == 0)
+    {
+        return true;
+    }
+    UE_LOG(LogTemp, Warning, TEXT("SO_TIMESTAMPNS not supported (errno %d), receive wake latency is not measured"), errno);
+#endif
+    return false;
+}
+
+bool FFrameDecoder::PeekArrivalAge(FSocket& Socket, int64& OutAgeNanos)
+{
+#if WITH_SOCKET_RECV_TIMESTAMPS
+    // 先取当前时间，peek本身的系统调用不计入
+    timespec Now;
+    clock_gettime(CLOCK_REALTIME, &Now);
+
+    // TCP的时间戳来自本次读到的数据包，只peek一个字节即为队列中最早到达的数据
+    uint8 Byte = 0;
+    iovec IoVec{ &Byte, 1 };
+    alignas(cmsghdr) uint8 Control[CMSG_SPACE(sizeof(timespec))];
+    msghdr Message = {};
+    Message.msg_iov = &IoVec;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = sizeof(Control);
+
+    const int NativeSocket = (int)static_cast<FSocketBSD&>(Socket).GetNativeSocket();
+    if (recvmsg(NativeSocket, &Message, MSG_PEEK | MSG_DONTWAIT) <= 0)
+    {
+        return false;
+    }
+
+    for (cmsghdr* Cmsg = CMSG_FIRSTHDR(&Message); Cmsg; Cmsg = CMSG_NXTHDR(&Message, Cmsg))
+    {
+        if (Cmsg->cmsg_level == SOL_SOCKET && Cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            timespec Arrival;
+            FMemory::Memcpy(&Arrival, CMSG_DATA(Cmsg), sizeof(Arrival));
+            const int64 AgeNanos = (int64)(Now.tv_sec - Arrival.tv_sec) * 1000000000 + (Now.tv_nsec - Arrival.tv_nsec);
+            OutAgeNanos = FMath::Max<int64>(0, AgeNanos);
+            return true;
+        }
+    }
+#endif
+    return false;
+}
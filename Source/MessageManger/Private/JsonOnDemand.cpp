@@ -0,0 +1,736 @@
+﻿#include "JsonOnDemand.h"
+#include "Utf8Transcoder.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define JSON_ON_DEMAND_SSE2 1
+#define JSON_ON_DEMAND_NEON 0
+#elif PLATFORM_CPU_ARM_FAMILY && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define JSON_ON_DEMAND_SSE2 0
+#define JSON_ON_DEMAND_NEON 1
+#else
+#define JSON_ON_DEMAND_SSE2 0
+#define JSON_ON_DEMAND_NEON 0
+#endif
+
+namespace
+{
+    // 64字节块中各类字符的位图，第i位对应第i个字节
+    struct FBlockMasks
+    {
+        uint64 Quote;
+        uint64 Backslash;
+        uint64 Operator;
+        uint64 Control;
+    };
+
+#if JSON_ON_DEMAND_NEON
+    FORCEINLINE uint64 NeonMovemask(uint8x16_t Value)
+    {
+        static const uint8 BitWeights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t Masked = vandq_u8(Value, vld1q_u8(BitWeights));
+        return (uint64)vaddv_u8(vget_low_u8(Masked)) | ((uint64)vaddv_u8(vget_high_u8(Masked)) << 8);
+    }
+#endif
+
+    FORCEINLINE FBlockMasks ClassifyBlock(const uint8* Block)
+    {
+        FBlockMasks Masks = {};
+#if JSON_ON_DEMAND_SSE2
+        for (int32 Lane = 0; Lane < 4; ++Lane)
+        {
+            const __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Block + Lane * 16));
+            // '['|0x20 == '{'，']'|0x20 == '}'
+            const __m128i Folded = _mm_or_si128(Bytes, _mm_set1_epi8(0x20));
+            const __m128i Operator = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(Folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(Folded, _mm_set1_epi8('}'))),
+                _mm_or_si128(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8(':')), _mm_cmpeq_epi8(Bytes, _mm_set1_epi8(','))));
+            const __m128i Control = _mm_cmpeq_epi8(_mm_max_epu8(Bytes, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+            const int32 Shift = Lane * 16;
+            Masks.Quote |= (uint64)(uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('"'))) << Shift;
+            Masks.Backslash |= (uint64)(uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('\\'))) << Shift;
+            Masks.Operator |= (uint64)(uint32)_mm_movemask_epi8(Operator) << Shift;
+            Masks.Control |= (uint64)(uint32)_mm_movemask_epi8(Control) << Shift;
+        }
+#elif JSON_ON_DEMAND_NEON
+        for (int32 Lane = 0; Lane < 4; ++Lane)
+        {
+            const uint8x16_t Bytes = vld1q_u8(Block + Lane * 16);
+            const uint8x16_t Folded = vorrq_u8(Bytes, vdupq_n_u8(0x20));
+            const uint8x16_t Operator = vorrq_u8(
+                vorrq_u8(vceqq_u8(Folded, vdupq_n_u8('{')), vceqq_u8(Folded, vdupq_n_u8('}'))),
+                vorrq_u8(vceqq_u8(Bytes, vdupq_n_u8(':')), vceqq_u8(Bytes, vdupq_n_u8(','))));
+            const int32 Shift = Lane * 16;
+            Masks.Quote |= NeonMovemask(vceqq_u8(Bytes, vdupq_n_u8('"'))) << Shift;
+            Masks.Backslash |= NeonMovemask(vceqq_u8(Bytes, vdupq_n_u8('\\'))) << Shift;
+            Masks.Operator |= NeonMovemask(Operator) << Shift;
+            Masks.Control |= NeonMovemask(vcltq_u8(Bytes, vdupq_n_u8(0x20))) << Shift;
+        }
+#else
+        for (int32 Index = 0; Index < 64; ++Index)
+        {
+            const uint8 Char = Block[Index];
+            const uint64 Bit = 1ull << Index;
+            Masks.Quote |= (Char == '"') ? Bit : 0;
+            Masks.Backslash |= (Char == '\\') ? Bit : 0;
+            Masks.Operator |= (Char == '{' || Char == '}' || Char == '[' || Char == ']' || Char == ':' || Char == ',') ? Bit : 0;
+            Masks.Control |= (Char < 0x20) ? Bit : 0;
+        }
+#endif
+        return Masks;
+    }
+
+    // 被反斜杠转义的字符位图（奇数长度的反斜杠序列之后的字符），PrevEscaped在块之间传递
+    FORCEINLINE uint64 FindEscaped(uint64 Backslash, uint64& PrevEscaped)
+    {
+        Backslash &= ~PrevEscaped;
+        const uint64 FollowsEscape = (Backslash << 1) | PrevEscaped;
+
+        // 用加法消掉从偶数位开始的序列，剩下的进位标记出奇数长度的序列
+        constexpr uint64 EvenBits = 0x5555555555555555ull;
+        const uint64 OddSequenceStarts = Backslash & ~EvenBits & ~FollowsEscape;
+        const uint64 SequencesStartingOnEvenBits = OddSequenceStarts + Backslash;
+        PrevEscaped = SequencesStartingOnEvenBits < OddSequenceStarts ? 1 : 0;
+        const uint64 InvertMask = SequencesStartingOnEvenBits << 1;
+        return (EvenBits ^ InvertMask) & FollowsEscape;
+    }
+
+    // 前缀异或：第i位为第0到i位的异或，用于从引号位图得到字符串范围
+    FORCEINLINE uint64 PrefixXor(uint64 Bits)
+    {
+        Bits ^= Bits << 1;
+        Bits ^= Bits << 2;
+        Bits ^= Bits << 4;
+        Bits ^= Bits << 8;
+        Bits ^= Bits << 16;
+        Bits ^= Bits << 32;
+        return Bits;
+    }
+
+    FORCEINLINE bool IsJsonWhitespace(uint8 Char)
+    {
+        return Char == ' ' || Char == '\n' || Char == '\r' || Char == '\t';
+    }
+
+    bool ContainsBackslash(const uint8* Data, int32 Length)
+    {
+        int32 Index = 0;
+#if JSON_ON_DEMAND_SSE2
+        for (; Index + 16 <= Length; Index += 16)
+        {
+            const __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + Index));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('\\'))) != 0)
+            {
+                return true;
+            }
+        }
+#elif JSON_ON_DEMAND_NEON
+        for (; Index + 16 <= Length; Index += 16)
+        {
+            if (vmaxvq_u8(vceqq_u8(vld1q_u8(Data + Index), vdupq_n_u8('\\'))) != 0)
+            {
+                return true;
+            }
+        }
+#endif
+        for (; Index < Length; ++Index)
+        {
+            if (Data[Index] == '\\')
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int32 HexValue(uint8 Char)
+    {
+        if (Char >= '0' && Char <= '9') return Char - '0';
+        if (Char >= 'a' && Char <= 'f') return Char - 'a' + 10;
+        if (Char >= 'A' && Char <= 'F') return Char - 'A' + 10;
+        return -1;
+    }
+
+    bool ParseHex4(const uint8* Data, uint32& OutValue)
+    {
+        OutValue = 0;
+        for (int32 Index = 0; Index < 4; ++Index)
+        {
+            const int32 Digit = HexValue(Data[Index]);
+            if (Digit < 0)
+            {
+                return false;
+            }
+            OutValue = (OutValue << 4) | (uint32)Digit;
+        }
+        return true;
+    }
+
+    // 处理字符串转义，结果为UTF-8；不成对的\u代理项写为U+FFFD
+    bool Unescape(const uint8* Data, int32 Length, TArray<uint8>& Out)
+    {
+        // 转义后不会变长（\uXXXX最多编码为4字节，\uXXXX\uXXXX为12字节→4字节）
+        Out.SetNumUninitialized(Length, EAllowShrinking::No);
+        uint8* Dest = Out.GetData();
+        int32 Index = 0;
+        while (Index < Length)
+        {
+            const uint8 Char = Data[Index++];
+            if (Char != '\\')
+            {
+                *Dest++ = Char;
+                continue;
+            }
+            if (Index >= Length)
+            {
+                return false;
+            }
+
+            const uint8 Escape = Data[Index++];
+            switch (Escape)
+            {
+            case '"': *Dest++ = '"'; break;
+            case '\\': *Dest++ = '\\'; break;
+            case '/': *Dest++ = '/'; break;
+            case 'b': *Dest++ = '\b'; break;
+            case 'f': *Dest++ = '\f'; break;
+            case 'n': *Dest++ = '\n'; break;
+            case 'r': *Dest++ = '\r'; break;
+            case 't': *Dest++ = '\t'; break;
+            case 'u':
+            {
+                uint32 CodePoint = 0;
+                if (Index + 4 > Length || !ParseHex4(Data + Index, CodePoint))
+                {
+                    return false;
+                }
+                Index += 4;
+
+                uint32 LowSurrogate = 0;
+                if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && Index + 6 <= Length
+                    && Data[Index] == '\\' && Data[Index + 1] == 'u' && ParseHex4(Data + Index + 2, LowSurrogate)
+                    && LowSurrogate >= 0xDC00 && LowSurrogate <= 0xDFFF)
+                {
+                    CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+                    Index += 6;
+                }
+                Dest += FUtf8Transcoder::EncodeCodePoint(CodePoint, Dest);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        Out.SetNum((int32)(Dest - Out.GetData()), EAllowShrinking::No);
+        return true;
+    }
+
+    // 已验证的UTF-8转为FString，复用OutString的缓冲区
+    void Utf8ToString(const uint8* Data, int32 Length, FString& OutString)
+    {
+        TArray<TCHAR>& CharArray = OutString.GetCharArray();
+        if (Length == 0)
+        {
+            CharArray.Reset();
+            return;
+        }
+        CharArray.SetNumUninitialized(FUtf8Transcoder::MaxUtf16Units(Length) + 1, EAllowShrinking::No);
+        const int32 Written = FUtf8Transcoder::Utf8ToUtf16(Data, Length, reinterpret_cast<UTF16CHAR*>(CharArray.GetData()));
+        CharArray[Written] = TEXT('\0');
+        CharArray.SetNum(Written + 1, EAllowShrinking::No);
+    }
+
+    // JSON数字语法：-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+    bool IsJsonNumber(FUtf8StringView Text, bool& bOutIsInteger)
+    {
+        const UTF8CHAR* Char = Text.GetData();
+        const UTF8CHAR* End = Char + Text.Len();
+        auto IsDigit = [](UTF8CHAR C) { return C >= '0' && C <= '9'; };
+
+        bOutIsInteger = true;
+        if (Char < End && *Char == '-')
+        {
+            ++Char;
+        }
+        if (Char >= End || !IsDigit(*Char))
+        {
+            return false;
+        }
+        if (*Char == '0')
+        {
+            ++Char;
+        }
+        else
+        {
+            while (Char < End && IsDigit(*Char)) ++Char;
+        }
+        if (Char < End && *Char == '.')
+        {
+            bOutIsInteger = false;
+            ++Char;
+            if (Char >= End || !IsDigit(*Char)) return false;
+            while (Char < End && IsDigit(*Char)) ++Char;
+        }
+        if (Char < End && (*Char == 'e' || *Char == 'E'))
+        {
+            bOutIsInteger = false;
+            ++Char;
+            if (Char < End && (*Char == '+' || *Char == '-')) ++Char;
+            if (Char >= End || !IsDigit(*Char)) return false;
+            while (Char < End && IsDigit(*Char)) ++Char;
+        }
+        return Char == End;
+    }
+}
+
+bool FJsonOnDemandDocument::Parse(const uint8* InData, int32 InLength)
+{
+    Data = InData;
+    Length = (InData && InLength > 0) ? InLength : 0;
+    bValid = false;
+
+    if (Length == 0)
+    {
+        return false;
+    }
+    if (!FUtf8Transcoder::IsValidUtf8(Data, Length) || !BuildStructuralIndex() || !MatchBrackets())
+    {
+        return false;
+    }
+
+    // 根值之后只能有空白
+    bValid = true;
+    const FJsonOnDemandValue Root = GetRoot();
+    if (!Root.IsValid() || Root.GetEndToken() != Structurals.Num() - 1)
+    {
+        bValid = false;
+        return false;
+    }
+    if (Root.GetType() == EJsonOnDemandType::Object || Root.GetType() == EJsonOnDemandType::Array
+        || Root.GetType() == EJsonOnDemandType::String)
+    {
+        const FUtf8StringView RootText = Root.GetRawJson();
+        for (int32 Index = Root.Start + RootText.Len(); Index < Length; ++Index)
+        {
+            if (!IsJsonWhitespace(Data[Index]))
+            {
+                bValid = false;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool FJsonOnDemandDocument::BuildStructuralIndex()
+{
+    Structurals.Reset();
+    int32 Count = 0;
+
+    uint64 PrevEscaped = 0;
+    uint64 PrevInString = 0;
+    uint64 ControlInString = 0;
+
+    for (int32 Offset = 0; Offset < Length; Offset += 64)
+    {
+        // 最后不足64字节的块用空格补齐
+        const uint8* Block = Data + Offset;
+        uint8 Padded[64];
+        if (Length - Offset < 64)
+        {
+            FMemory::Memset(Padded, ' ', sizeof(Padded));
+            FMemory::Memcpy(Padded, Block, Length - Offset);
+            Block = Padded;
+        }
+
+        const FBlockMasks Masks = ClassifyBlock(Block);
+        const uint64 Escaped = FindEscaped(Masks.Backslash, PrevEscaped);
+        const uint64 Quote = Masks.Quote & ~Escaped;
+
+        // 字符串范围包含左引号，不包含右引号
+        const uint64 InString = PrefixXor(Quote) ^ PrevInString;
+        PrevInString = (uint64)((int64)InString >> 63);
+        ControlInString |= Masks.Control & InString;
+
+        uint64 Structural = (Masks.Operator & ~InString) | Quote;
+        if (Structurals.Num() - Count < 64)
+        {
+            Structurals.AddUninitialized(64);
+        }
+        uint32* Out = Structurals.GetData() + Count;
+        while (Structural != 0)
+        {
+            *Out++ = (uint32)(Offset + FMath::CountTrailingZeros64(Structural));
+            Structural &= Structural - 1;
+        }
+        Count = (int32)(Out - Structurals.GetData());
+    }
+
+    Structurals.SetNum(Count, EAllowShrinking::No);
+    Structurals.Add((uint32)Length);
+    return PrevInString == 0 && ControlInString == 0;
+}
+
+bool FJsonOnDemandDocument::MatchBrackets()
+{
+    const int32 Count = Structurals.Num() - 1;
+    Matching.SetNumUninitialized(Count, EAllowShrinking::No);
+    OpenStack.Reset();
+
+    for (int32 Index = 0; Index < Count; ++Index)
+    {
+        const uint8 Char = Data[Structurals[Index]];
+        if (Char == '{' || Char == '[')
+        {
+            OpenStack.Add(Index);
+        }
+        else if (Char == '}' || Char == ']')
+        {
+            // '{'和'}'、'['和']'的编码都相差2
+            if (OpenStack.Num() == 0 || Data[Structurals[OpenStack.Last()]] != Char - 2)
+            {
+                return false;
+            }
+            Matching[OpenStack.Pop(EAllowShrinking::No)] = Index;
+        }
+    }
+    return OpenStack.Num() == 0;
+}
+
+FJsonOnDemandValue FJsonOnDemandDocument::MakeValue(int32 After, int32 InToken) const
+{
+    int32 ValueStart = After;
+    while (ValueStart < Length && IsJsonWhitespace(Data[ValueStart]))
+    {
+        ++ValueStart;
+    }
+    if (ValueStart >= Length || InToken >= Structurals.Num())
+    {
+        return FJsonOnDemandValue();
+    }
+
+    // 值的位置上是分隔符说明缺少值
+    const uint8 Char = Data[ValueStart];
+    if (Char == ',' || Char == ':' || Char == '}' || Char == ']')
+    {
+        return FJsonOnDemandValue();
+    }
+    return FJsonOnDemandValue(this, ValueStart, InToken);
+}
+
+FJsonOnDemandValue FJsonOnDemandDocument::GetRoot() const
+{
+    return bValid ? MakeValue(0, 0) : FJsonOnDemandValue();
+}
+
+EJsonOnDemandType FJsonOnDemandValue::GetType() const
+{
+    if (!Document)
+    {
+        return EJsonOnDemandType::Invalid;
+    }
+    switch (Document->Data[Start])
+    {
+    case '{': return EJsonOnDemandType::Object;
+    case '[': return EJsonOnDemandType::Array;
+    case '"': return EJsonOnDemandType::String;
+    case 't':
+    case 'f': return EJsonOnDemandType::Boolean;
+    case 'n': return EJsonOnDemandType::Null;
+    default:
+        return (Document->Data[Start] == '-' || (Document->Data[Start] >= '0' && Document->Data[Start] <= '9'))
+            ? EJsonOnDemandType::Number : EJsonOnDemandType::Invalid;
+    }
+}
+
+int32 FJsonOnDemandValue::GetEndToken() const
+{
+    switch (Document->Data[Start])
+    {
+    case '{':
+    case '[':
+        return Document->Matching[Token] + 1;
+    case '"':
+        return Token + 2;
+    default:
+        // 标量不在索引中，其后的分隔符就是Token
+        return Token;
+    }
+}
+
+FUtf8StringView FJsonOnDemandValue::GetScalarText() const
+{
+    int32 End = (int32)Document->Structurals[Token];
+    while (End > Start && IsJsonWhitespace(Document->Data[End - 1]))
+    {
+        --End;
+    }
+    return FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Document->Data + Start), End - Start);
+}
+
+FUtf8StringView FJsonOnDemandValue::GetRawJson() const
+{
+    if (!Document)
+    {
+        return FUtf8StringView();
+    }
+
+    const EJsonOnDemandType Type = GetType();
+    if (Type == EJsonOnDemandType::Object || Type == EJsonOnDemandType::Array || Type == EJsonOnDemandType::String)
+    {
+        // 右括号或右引号是值之前的最后一个索引项
+        const int32 End = (int32)Document->Structurals[GetEndToken() - 1] + 1;
+        return FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Document->Data + Start), End - Start);
+    }
+    return GetScalarText();
+}
+
+bool FJsonOnDemandValue::ForEachField(TFunctionRef<bool(FUtf8StringView Key, const FJsonOnDemandValue& Value)> Visitor) const
+{
+    if (GetType() != EJsonOnDemandType::Object)
+    {
+        return false;
+    }
+
+    const FJsonOnDemandDocument& Doc = *Document;
+    int32 Current = Token + 1;
+    if (Doc.TokenChar(Current) == '}')
+    {
+        return true;
+    }
+
+    while (true)
+    {
+        // "key" : value
+        if (Doc.TokenChar(Current) != '"' || Doc.TokenChar(Current + 1) != '"' || Doc.TokenChar(Current + 2) != ':')
+        {
+            return false;
+        }
+        const int32 KeyStart = (int32)Doc.Structurals[Current] + 1;
+        const FUtf8StringView Key(reinterpret_cast<const UTF8CHAR*>(Doc.Data + KeyStart), (int32)Doc.Structurals[Current + 1] - KeyStart);
+
+        const FJsonOnDemandValue Value = Doc.MakeValue((int32)Doc.Structurals[Current + 2] + 1, Current + 3);
+        if (!Value.IsValid())
+        {
+            return false;
+        }
+        if (!Visitor(Key, Value))
+        {
+            return true;
+        }
+
+        Current = Value.GetEndToken();
+        const uint8 Separator = Doc.TokenChar(Current);
+        if (Separator == '}')
+        {
+            return true;
+        }
+        if (Separator != ',')
+        {
+            return false;
+        }
+        ++Current;
+    }
+}
+
+FJsonOnDemandValue FJsonOnDemandValue::FindField(FUtf8StringView Key) const
+{
+    FJsonOnDemandValue Found;
+    ForEachField([&Key, &Found](FUtf8StringView FieldKey, const FJsonOnDemandValue& Value)
+    {
+        if (FieldKey.Equals(Key, ESearchCase::CaseSensitive))
+        {
+            Found = Value;
+            return false;
+        }
+        return true;
+    });
+    return Found;
+}
+
+bool FJsonOnDemandValue::ForEachElement(TFunctionRef<bool(const FJsonOnDemandValue& Element)> Visitor) const
+{
+    if (GetType() != EJsonOnDemandType::Array)
+    {
+        return false;
+    }
+
+    const FJsonOnDemandDocument& Doc = *Document;
+
+    // 空数组：'['之后第一个非空白字符就是']'
+    int32 Next = Start + 1;
+    while (Next < Doc.Length && IsJsonWhitespace(Doc.Data[Next]))
+    {
+        ++Next;
+    }
+    if (Doc.Data[Next] == ']')
+    {
+        return true;
+    }
+
+    int32 Current = Token;
+    while (true)
+    {
+        const FJsonOnDemandValue Element = Doc.MakeValue((int32)Doc.Structurals[Current] + 1, Current + 1);
+        if (!Element.IsValid())
+        {
+            return false;
+        }
+        if (!Visitor(Element))
+        {
+            return true;
+        }
+
+        Current = Element.GetEndToken();
+        const uint8 Separator = Doc.TokenChar(Current);
+        if (Separator == ']')
+        {
+            return true;
+        }
+        if (Separator != ',')
+        {
+            return false;
+        }
+    }
+}
+
+bool FJsonOnDemandValue::GetRawString(FUtf8StringView& OutString) const
+{
+    if (GetType() != EJsonOnDemandType::String)
+    {
+        return false;
+    }
+    const int32 Begin = Start + 1;
+    OutString = FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Document->Data + Begin), (int32)Document->Structurals[Token + 1] - Begin);
+    return true;
+}
+
+bool FJsonOnDemandValue::GetUtf8String(TArray<uint8>& Scratch, FUtf8StringView& OutString) const
+{
+    FUtf8StringView Raw;
+    if (!GetRawString(Raw))
+    {
+        return false;
+    }
+
+    const uint8* RawData = reinterpret_cast<const uint8*>(Raw.GetData());
+    if (!ContainsBackslash(RawData, Raw.Len()))
+    {
+        OutString = Raw;
+        return true;
+    }
+
+    if (!Unescape(RawData, Raw.Len(), Scratch))
+    {
+        return false;
+    }
+    OutString = FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(Scratch.GetData()), Scratch.Num());
+    return true;
+}
+
+bool FJsonOnDemandValue::GetString(FString& OutString) const
+{
+    FUtf8StringView Raw;
+    if (!GetRawString(Raw))
+    {
+        return false;
+    }
+
+    // 文档已整体验证过UTF-8，引号处切开的子串仍然合法，直接转换
+    const uint8* RawData = reinterpret_cast<const uint8*>(Raw.GetData());
+    if (!ContainsBackslash(RawData, Raw.Len()))
+    {
+        Utf8ToString(RawData, Raw.Len(), OutString);
+        return true;
+    }
+
+    TArray<uint8>& Scratch = Document->UnescapeScratch;
+    if (!Unescape(RawData, Raw.Len(), Scratch))
+    {
+        return false;
+    }
+    Utf8ToString(Scratch.GetData(), Scratch.Num(), OutString);
+    return true;
+}
+
+bool FJsonOnDemandValue::GetDouble(double& OutValue) const
+{
+    if (GetType() != EJsonOnDemandType::Number)
+    {
+        return false;
+    }
+
+    const FUtf8StringView Text = GetScalarText();
+    bool bIsInteger = false;
+    ANSICHAR Buffer[128];
+    if (Text.Len() >= (int32)UE_ARRAY_COUNT(Buffer) || !IsJsonNumber(Text, bIsInteger))
+    {
+        return false;
+    }
+    FMemory::Memcpy(Buffer, Text.GetData(), Text.Len());
+    Buffer[Text.Len()] = '\0';
+    OutValue = FCStringAnsi::Atod(Buffer);
+    return true;
+}
+
+bool FJsonOnDemandValue::GetInt64(int64& OutValue) const
+{
+    if (GetType() != EJsonOnDemandType::Number)
+    {
+        return false;
+    }
+
+    const FUtf8StringView Text = GetScalarText();
+    bool bIsInteger = false;
+    if (!IsJsonNumber(Text, bIsInteger) || !bIsInteger)
+    {
+        return false;
+    }
+
+    const bool bNegative = Text[0] == '-';
+    uint64 Magnitude = 0;
+    for (int32 Index = bNegative ? 1 : 0; Index < Text.Len(); ++Index)
+    {
+        const uint64 Digit = (uint64)(Text[Index] - '0');
+        if (Magnitude > (MAX_uint64 - Digit) / 10)
+        {
+            return false;
+        }
+        Magnitude = Magnitude * 10 + Digit;
+    }
+
+    const uint64 Limit = bNegative ? (uint64)MAX_int64 + 1 : (uint64)MAX_int64;
+    if (Magnitude > Limit)
+    {
+        return false;
+    }
+    OutValue = bNegative ? (int64)(0 - Magnitude) : (int64)Magnitude;
+    return true;
+}
+
+bool FJsonOnDemandValue::GetBool(bool& OutValue) const
+{
+    if (GetType() != EJsonOnDemandType::Boolean)
+    {
+        return false;
+    }
+
+    const FUtf8StringView Text = GetScalarText();
+    if (Text.Equals(UTF8TEXTVIEW("true"), ESearchCase::CaseSensitive))
+    {
+        OutValue = true;
+        return true;
+    }
+    if (Text.Equals(UTF8TEXTVIEW("false"), ESearchCase::CaseSensitive))
+    {
+        OutValue = false;
+        return true;
+    }
+    return false;
+}
+
+bool FJsonOnDemandValue::IsNull() const
+{
+    return GetType() == EJsonOnDemandType::Null && GetScalarText().Equals(UTF8TEXTVIEW("null"), ESearchCase::CaseSensitive);
+}
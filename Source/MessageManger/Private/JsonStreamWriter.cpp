@@ -0,0 +1,243 @@
+﻿#include "JsonStreamWriter.h"
+#include "JsonOnDemand.h"
+#include "Utf8Transcoder.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define JSON_STREAM_WRITER_SSE2 1
+#define JSON_STREAM_WRITER_NEON 0
+#elif PLATFORM_CPU_ARM_FAMILY && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define JSON_STREAM_WRITER_SSE2 0
+#define JSON_STREAM_WRITER_NEON 1
+#else
+#define JSON_STREAM_WRITER_SSE2 0
+#define JSON_STREAM_WRITER_NEON 0
+#endif
+
+namespace
+{
+    // 一个16字符块转义后的最大字节数（\u001F占6字节）
+    constexpr int32 MaxEscapedBlockBytes = 16 * 6;
+
+    // 16个码元都是不需要转义的ASCII（0x20-0x7F且不是'"'和'\\'）时压缩为16字节写入Dest，否则返回false
+    FORCEINLINE bool TryCopyPlainAscii16(const UTF16CHAR* Source, uint8* Dest)
+    {
+#if JSON_STREAM_WRITER_SSE2
+        const __m128i Low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source));
+        const __m128i High = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + 8));
+        const __m128i NonAscii = _mm_and_si128(_mm_or_si128(Low, High), _mm_set1_epi16((short)0xFF80));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(NonAscii, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+        // 全部小于0x80，按有符号比较控制字符是安全的
+        const __m128i Bytes = _mm_packus_epi16(Low, High);
+        const __m128i NeedsEscape = _mm_or_si128(_mm_cmplt_epi8(Bytes, _mm_set1_epi8(0x20)),
+            _mm_or_si128(_mm_cmpeq_epi8(Bytes, _mm_set1_epi8('"')), _mm_cmpeq_epi8(Bytes, _mm_set1_epi8('\\'))));
+        if (_mm_movemask_epi8(NeedsEscape) != 0)
+        {
+            return false;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest), Bytes);
+        return true;
+#elif JSON_STREAM_WRITER_NEON
+        const uint16x8_t Low = vld1q_u16(reinterpret_cast<const uint16*>(Source));
+        const uint16x8_t High = vld1q_u16(reinterpret_cast<const uint16*>(Source + 8));
+        if (vmaxvq_u16(vorrq_u16(Low, High)) >= 0x80)
+        {
+            return false;
+        }
+        const uint8x16_t Bytes = vcombine_u8(vmovn_u16(Low), vmovn_u16(High));
+        const uint8x16_t NeedsEscape = vorrq_u8(vcltq_u8(Bytes, vdupq_n_u8(0x20)),
+            vorrq_u8(vceqq_u8(Bytes, vdupq_n_u8('"')), vceqq_u8(Bytes, vdupq_n_u8('\\'))));
+        if (vmaxvq_u8(NeedsEscape) != 0)
+        {
+            return false;
+        }
+        vst1q_u8(Dest, Bytes);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // 转义一个ASCII字符，不需要转义时返回0
+    FORCEINLINE int32 EscapeAscii(uint32 Char, uint8* Dest)
+    {
+        static constexpr ANSICHAR HexDigits[] = "0123456789ABCDEF";
+
+        ANSICHAR Short = 0;
+        switch (Char)
+        {
+        case '"': Short = '"'; break;
+        case '\\': Short = '\\'; break;
+        case '\n': Short = 'n'; break;
+        case '\r': Short = 'r'; break;
+        case '\t': Short = 't'; break;
+        case '\b': Short = 'b'; break;
+        case '\f': Short = 'f'; break;
+        default:
+            if (Char >= 0x20)
+            {
+                return 0;
+            }
+            Dest[0] = '\\';
+            Dest[1] = 'u';
+            Dest[2] = '0';
+            Dest[3] = '0';
+            Dest[4] = (uint8)HexDigits[Char >> 4];
+            Dest[5] = (uint8)HexDigits[Char & 0xF];
+            return 6;
+        }
+        Dest[0] = '\\';
+        Dest[1] = (uint8)Short;
+        return 2;
+    }
+}
+
+void FJsonStreamWriter::BeginObject()
+{
+    if (bNeedsComma)
+    {
+        Output.Add(',');
+    }
+    Output.Add('{');
+    bNeedsComma = false;
+}
+
+void FJsonStreamWriter::EndObject()
+{
+    Output.Add('}');
+    bNeedsComma = true;
+}
+
+void FJsonStreamWriter::WriteKey(FAnsiStringView Key)
+{
+    if (bNeedsComma)
+    {
+        Output.Add(',');
+    }
+    Output.Add('"');
+    Output.Append(reinterpret_cast<const uint8*>(Key.GetData()), Key.Len());
+    Output.Add('"');
+    Output.Add(':');
+    bNeedsComma = true;
+}
+
+void FJsonStreamWriter::WriteStringField(FAnsiStringView Key, FStringView Value)
+{
+    WriteKey(Key);
+    AppendEscapedString(Value, Output);
+}
+
+void FJsonStreamWriter::WriteUInt64Field(FAnsiStringView Key, uint64 Value)
+{
+    WriteKey(Key);
+
+    // 从低位向高位写入临时缓冲区
+    uint8 Digits[20];
+    int32 Count = 0;
+    do
+    {
+        Digits[UE_ARRAY_COUNT(Digits) - 1 - Count++] = (uint8)('0' + Value % 10);
+        Value /= 10;
+    }
+    while (Value != 0);
+    Output.Append(Digits + UE_ARRAY_COUNT(Digits) - Count, Count);
+}
+
+void FJsonStreamWriter::WriteBoolField(FAnsiStringView Key, bool bValue)
+{
+    WriteKey(Key);
+    const FAnsiStringView Literal = bValue ? ANSITEXTVIEW("true") : ANSITEXTVIEW("false");
+    Output.Append(reinterpret_cast<const uint8*>(Literal.GetData()), Literal.Len());
+}
+
+bool FJsonStreamWriter::WriteRawField(FAnsiStringView Key, FStringView RawJson)
+{
+    const int32 RollbackNum = Output.Num();
+    const bool bRollbackNeedsComma = bNeedsComma;
+
+    WriteKey(Key);
+    const int32 ValueStart = Output.Num();
+    Output.AddUninitialized(FUtf8Transcoder::MaxUtf8Bytes(RawJson.Len()));
+    const int32 Written = FUtf8Transcoder::Utf16ToUtf8(reinterpret_cast<const UTF16CHAR*>(RawJson.GetData()), RawJson.Len(), Output.GetData() + ValueStart);
+    Output.SetNum(ValueStart + Written, EAllowShrinking::No);
+
+    // 嵌入前验证一次，避免一条不合法的Data破坏整个信封
+    static thread_local FJsonOnDemandDocument Validator;
+    if (!Validator.Parse(Output.GetData() + ValueStart, Written))
+    {
+        Output.SetNum(RollbackNum, EAllowShrinking::No);
+        bNeedsComma = bRollbackNeedsComma;
+        return false;
+    }
+    return true;
+}
+
+void FJsonStreamWriter::AppendEscapedString(FStringView Value, TArray<uint8>& Output)
+{
+    static_assert(sizeof(TCHAR) == sizeof(UTF16CHAR), "FJsonStreamWriter expects UTF-16 TCHAR");
+
+    const UTF16CHAR* Source = reinterpret_cast<const UTF16CHAR*>(Value.GetData());
+    const int32 Length = Value.Len();
+
+    // 按"全部是普通ASCII"预留，遇到需要转义或多字节的字符时再按块扩容
+    int32 WritePos = Output.Num();
+    Output.AddUninitialized(Length + 2);
+    Output[WritePos++] = '"';
+
+    int32 Index = 0;
+    while (Index < Length)
+    {
+        if (Output.Num() - WritePos < MaxEscapedBlockBytes)
+        {
+            Output.AddUninitialized(MaxEscapedBlockBytes + (Length - Index));
+        }
+        uint8* const BlockStart = Output.GetData() + WritePos;
+        uint8* Out = BlockStart;
+
+        // 普通ASCII快速路径
+        if (Index + 16 <= Length && TryCopyPlainAscii16(Source + Index, Out))
+        {
+            Index += 16;
+            WritePos += 16;
+            continue;
+        }
+
+        // 逐个字符转义/编码，直到下一个16字符块
+        const int32 BlockEnd = FMath::Min(Length, Index + 16);
+        while (Index < BlockEnd)
+        {
+            uint32 CodePoint = Source[Index++];
+            if (CodePoint < 0x80)
+            {
+                const int32 Escaped = EscapeAscii(CodePoint, Out);
+                if (Escaped > 0)
+                {
+                    Out += Escaped;
+                }
+                else
+                {
+                    *Out++ = (uint8)CodePoint;
+                }
+                continue;
+            }
+            if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && Index < Length && Source[Index] >= 0xDC00 && Source[Index] <= 0xDFFF)
+            {
+                CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + ((uint32)Source[Index++] - 0xDC00);
+            }
+            // 不成对的代理项由EncodeCodePoint写为U+FFFD
+            Out += FUtf8Transcoder::EncodeCodePoint(CodePoint, Out);
+        }
+        WritePos += (int32)(Out - BlockStart);
+    }
+
+    if (WritePos >= Output.Num())
+    {
+        Output.AddUninitialized(1);
+    }
+    Output[WritePos++] = '"';
+    Output.SetNum(WritePos, EAllowShrinking::No);
+}
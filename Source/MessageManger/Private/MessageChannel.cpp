@@ -0,0 +1,171 @@
+﻿#include "MessageChannel.h"
+#include "Containers/LockFreeList.h"
+
+namespace
+{
+    constexpr SIZE_T FrameSizeGranularity = 64;
+    constexpr int32 NumFrameSizeClasses = 32;
+
+    TLockFreePointerListUnordered<void, PLATFORM_CACHE_LINE_SIZE>& GetFreeFrames(int32 SizeClass)
+    {
+        static TLockFreePointerListUnordered<void, PLATFORM_CACHE_LINE_SIZE> FreeFrames[NumFrameSizeClasses];
+        return FreeFrames[SizeClass];
+    }
+
+    int32 GetSizeClass(SIZE_T Size)
+    {
+        return (int32)((Size + FrameSizeGranularity - 1) / FrameSizeGranularity) - 1;
+    }
+}
+
+void* FCoroutineFramePool::Allocate(SIZE_T Size)
+{
+    const int32 SizeClass = GetSizeClass(Size);
+    if (SizeClass >= NumFrameSizeClasses)
+    {
+        return FMemory::Malloc(Size);
+    }
+    if (void* Frame = GetFreeFrames(SizeClass).Pop())
+    {
+        return Frame;
+    }
+    return FMemory::Malloc((SizeClass + 1) * FrameSizeGranularity);
+}
+
+void FCoroutineFramePool::Free(void* Frame, SIZE_T Size)
+{
+    const int32 SizeClass = GetSizeClass(Size);
+    if (SizeClass >= NumFrameSizeClasses)
+    {
+        FMemory::Free(Frame);
+        return;
+    }
+    GetFreeFrames(SizeClass).Push(Frame);
+}
+
+FMessageChannel::FMessageChannel(UTCPCommunicationSubsystem& InSubsystem)
+    : Subsystem(&InSubsystem)
+{
+}
+
+FMessageChannel::~FMessageChannel()
+{
+    Close();
+}
+
+void FMessageChannel::FReceiveAwaiter::await_suspend(std::coroutine_handle<> Handle)
+{
+    check(IsInGameThread());
+    Continuation = Handle;
+    Channel.AddWaiter(*this);
+}
+
+bool FMessageChannel::FCallAwaiter::await_suspend(std::coroutine_handle<> Handle)
+{
+    Continuation = Handle;
+    UTCPCommunicationSubsystem* TargetSubsystem = Channel.Subsystem.Get();
+    if (!TargetSubsystem || Channel.bClosed)
+    {
+        Result = FRpcResult{ ERpcStatus::Disconnected };
+        return false;
+    }
+
+    TargetSubsystem->CallRemote(Request, *this, TimeoutSeconds, ResponseType);
+
+    // 已经完成（例如未连接）时不挂起
+    return !bHandoff.exchange(true, std::memory_order_acq_rel);
+}
+
+void FMessageChannel::FCallAwaiter::OnRpcComplete(FRpcResult&& InResult)
+{
+    Result = MoveTemp(InResult);
+    if (bHandoff.exchange(true, std::memory_order_acq_rel))
+    {
+        // 协程已经挂起，在完成调用的线程（游戏线程分发收件箱时）上直接恢复
+        Continuation.resume();
+    }
+}
+
+void FMessageChannel::AddWaiter(FReceiveAwaiter& Awaiter)
+{
+    const uint16 TypeId = FMessageTypeRegistry::MakeId(Awaiter.Type);
+    FTypeWaiters& TypeWaiters = Waiters.FindOrAdd(TypeId);
+
+    // 每种类型只订阅一次，之后的等待只修改链表
+    UTCPCommunicationSubsystem* TargetSubsystem = Subsystem.Get();
+    if (!TypeWaiters.Subscription.IsValid() && TargetSubsystem)
+    {
+        TypeWaiters.Subscription = TargetSubsystem->SubscribeToMessageType(Awaiter.Type,
+            FOnMessageReceived::CreateRaw(this, &FMessageChannel::HandleMessage, TypeId));
+    }
+
+    Awaiter.Next = nullptr;
+    if (TypeWaiters.Tail)
+    {
+        TypeWaiters.Tail->Next = &Awaiter;
+    }
+    else
+    {
+        TypeWaiters.Head = &Awaiter;
+    }
+    TypeWaiters.Tail = &Awaiter;
+}
+
+void FMessageChannel::HandleMessage(const FNetworkMessage& Message, uint16 TypeId)
+{
+    FTypeWaiters* TypeWaiters = Waiters.Find(TypeId);
+    if (!TypeWaiters || !TypeWaiters->Head)
+    {
+        return;
+    }
+
+    // 先摘下整个链表，恢复的协程再次等待同一类型时等的是下一条消息
+    FReceiveAwaiter* Head = TypeWaiters->Head;
+    TypeWaiters->Head = nullptr;
+    TypeWaiters->Tail = nullptr;
+    ResumeWaiters(Head, &Message);
+}
+
+void FMessageChannel::ResumeWaiters(FReceiveAwaiter* Head, const FNetworkMessage* Message)
+{
+    while (Head)
+    {
+        // 恢复后awaiter随协程帧一起失效，先取出下一个
+        FReceiveAwaiter* Awaiter = Head;
+        Head = Head->Next;
+        if (Message)
+        {
+            Awaiter->Result = *Message;
+        }
+        Awaiter->Continuation.resume();
+    }
+}
+
+void FMessageChannel::Close()
+{
+    if (bClosed)
+    {
+        return;
+    }
+    bClosed = true;
+
+    UTCPCommunicationSubsystem* TargetSubsystem = Subsystem.Get();
+    TArray<FReceiveAwaiter*> Pending;
+    for (TPair<uint16, FTypeWaiters>& Pair : Waiters)
+    {
+        if (TargetSubsystem && Pair.Value.Subscription.IsValid())
+        {
+            TargetSubsystem->UnsubscribeFromMessageType(Pair.Value.Subscription);
+        }
+        if (Pair.Value.Head)
+        {
+            Pending.Add(Pair.Value.Head);
+        }
+    }
+    Waiters.Empty();
+
+    for (FReceiveAwaiter* Head : Pending)
+    {
+        ResumeWaiters(Head, nullptr);
+    }
+}
@@ -0,0 +1,76 @@
+﻿#include "MessageInbox.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+
+void FMessageInbox::Enqueue(FInboxEntry&& Entry)
+{
+    if (Entry.bCoalesce)
+    {
+        const TPair<uint16, uint64> Key(Entry.TypeId, Entry.CoalesceKey);
+        {
+            FScopeLock ScopeLock(&CoalesceLock);
+            if (FInboxEntry* Pending = CoalescedEntries.Find(Key))
+            {
+                // 已有占位条目在队列中，替换为最新的消息即可
+                *Pending = MoveTemp(Entry);
+                CoalescedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            CoalescedEntries.Add(Key, MoveTemp(Entry));
+        }
+
+        // 队列中只放占位条目，分发时再取出最新的消息
+        FInboxEntry Placeholder;
+        Placeholder.TypeId = Key.Key;
+        Placeholder.bCoalesce = true;
+        Placeholder.CoalesceKey = Key.Value;
+        Queue.Enqueue(MoveTemp(Placeholder));
+    }
+    else
+    {
+        Queue.Enqueue(MoveTemp(Entry));
+    }
+    Depth.fetch_add(1, std::memory_order_release);
+}
+
+int32 FMessageInbox::Drain(uint64 BudgetCycles, TFunctionRef<void(FInboxEntry&)> Handler)
+{
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    int32 Processed = 0;
+    while (TOptional<FInboxEntry> Entry = Queue.Dequeue())
+    {
+        Depth.fetch_sub(1, std::memory_order_relaxed);
+        if (Entry->bCoalesce)
+        {
+            // 移除后同一个键的新消息重新占位，排在当前队尾
+            FInboxEntry Latest;
+            {
+                FScopeLock ScopeLock(&CoalesceLock);
+                CoalescedEntries.RemoveAndCopyValue(TPair<uint16, uint64>(Entry->TypeId, Entry->CoalesceKey), Latest);
+            }
+            Handler(Latest);
+        }
+        else
+        {
+            Handler(Entry.GetValue());
+        }
+        ++Processed;
+
+        if (BudgetCycles > 0 && FPlatformTime::Cycles64() - StartCycles >= BudgetCycles)
+        {
+            break;
+        }
+    }
+    return Processed;
+}
+
+void FMessageInbox::Empty()
+{
+    while (Queue.Dequeue())
+    {
+        Depth.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    FScopeLock ScopeLock(&CoalesceLock);
+    CoalescedEntries.Empty();
+}
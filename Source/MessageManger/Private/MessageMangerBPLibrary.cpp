@@ -2,6 +2,9 @@
 
 #include "MessageMangerBPLibrary.h"
 #include "MessageManger.h"
+#include "Utf8Transcoder.h"
+
+static_assert(sizeof(TCHAR) == sizeof(UTF16CHAR), "FUtf8Transcoder expects UTF-16 TCHAR");
 
 UMessageMangerBPLibrary::UMessageMangerBPLibrary(const FObjectInitializer& ObjectInitializer)
 : Super(ObjectInitializer)
@@ -16,47 +19,82 @@ float UMessageMangerBPLibrary::MessageMangerSampleFunction(float Param)
 
 FString UMessageMangerBPLibrary::ConvertUtf8BinaryToString(const TArray<uint8>& BinaryData)
 {
-    if (BinaryData.Num() == 0)
+    return ConvertUtf8BinaryToString(BinaryData.GetData(), BinaryData.Num());
+}
+
+FString UMessageMangerBPLibrary::ConvertUtf8BinaryToString(const uint8* Data, int32 Length)
+{
+    if (!Data || Length <= 0)
     {
         return FString();
     }
 
-    // 确保数据以 null 结尾（避免解析越界）
-    TArray<uint8> NullTerminatedBytes = BinaryData;
-    NullTerminatedBytes.Add(0); // 添加 UTF-8 终止符 '\0'
+    // 非法 UTF-8 交给引擎转换，按引擎的规则替换非法字节
+    if (!FUtf8Transcoder::IsValidUtf8(Data, Length))
+    {
+        FUTF8ToTCHAR Converter(reinterpret_cast<const ANSICHAR*>(Data), Length);
+        return FString(Converter.Length(), Converter.Get());
+    }
+
+    // 按长度直接转换到 FString 的缓冲区，不复制源数据也不需要补 '\0'
+    FString Result;
+    TArray<TCHAR>& CharArray = Result.GetCharArray();
+    CharArray.SetNumUninitialized(FUtf8Transcoder::MaxUtf16Units(Length) + 1);
+    const int32 Written = FUtf8Transcoder::Utf8ToUtf16(Data, Length, reinterpret_cast<UTF16CHAR*>(CharArray.GetData()));
+    CharArray[Written] = TEXT('\0');
+    CharArray.SetNum(Written + 1, EAllowShrinking::Yes);
+    return Result;
+}
+
+void UMessageMangerBPLibrary::AppendStringAsUtf8(const TCHAR* Data, int32 Length, TArray<uint8>& OutBinaryData)
+{
+    if (!Data || Length <= 0)
+    {
+        return;
+    }
 
-    // 将字节数组转换为 UTF-8 字符串，再转为 FString
-    const char* Utf8Data = reinterpret_cast<const char*>(NullTerminatedBytes.GetData());
-    return FString(UTF8_TO_TCHAR(Utf8Data));
+    // 先按最大长度预留，转换后截断到实际长度
+    const int32 StartOffset = OutBinaryData.Num();
+    OutBinaryData.AddUninitialized(FUtf8Transcoder::MaxUtf8Bytes(Length));
+    const int32 Written = FUtf8Transcoder::Utf16ToUtf8(reinterpret_cast<const UTF16CHAR*>(Data), Length, OutBinaryData.GetData() + StartOffset);
+    OutBinaryData.SetNum(StartOffset + Written, EAllowShrinking::No);
 }
 
-// 将 const wchar_t* 转换为二进制字节数组
+// 将 const wchar_t* 转换为 UTF-8 字节数组
 void UMessageMangerBPLibrary::ConvertWCharToBinary(const wchar_t* WideStr, TArray<uint8>& OutBinaryData)
 {
+    OutBinaryData.Reset();
     if (!WideStr)
     {
-        OutBinaryData.Empty();
         return;
     }
 
-    // 1. 计算宽字符串长度（包含结尾的 '\0' 终止符）
+    // 计算宽字符串长度（不含结尾的 '\0'）
     int32 WideStrLength = 0;
     while (WideStr[WideStrLength] != L'\0')
     {
         WideStrLength++;
     }
-    WideStrLength++;  // 包含最后的 '\0'
-
-    // 2. 计算二进制数据总字节数（每个 wchar_t 占 sizeof(wchar_t) 字节）
-    int32 TotalBytes = WideStrLength * sizeof(wchar_t);
 
-    // 3. 分配内存并复制数据
-    OutBinaryData.SetNumUninitialized(TotalBytes);
-    FMemory::Memcpy(OutBinaryData.GetData(), WideStr, TotalBytes);
+    if constexpr (sizeof(wchar_t) == sizeof(TCHAR))
+    {
+        AppendStringAsUtf8(reinterpret_cast<const TCHAR*>(WideStr), WideStrLength, OutBinaryData);
+    }
+    else
+    {
+        // 4字节 wchar_t 是 UTF-32，逐个码点编码
+        OutBinaryData.SetNumUninitialized(WideStrLength * 4);
+        int32 Written = 0;
+        for (int32 Index = 0; Index < WideStrLength; ++Index)
+        {
+            Written += FUtf8Transcoder::EncodeCodePoint((uint32)WideStr[Index], OutBinaryData.GetData() + Written);
+        }
+        OutBinaryData.SetNum(Written, EAllowShrinking::No);
+    }
 }
 
 void UMessageMangerBPLibrary::ConvertFStringToBinary(FString Str, TArray<uint8>& outBinaryData)
 {
-    const wchar_t* Utf8Data = *Str;
-    UMessageMangerBPLibrary::ConvertWCharToBinary(Utf8Data, outBinaryData);
+    outBinaryData.Reset();
+    AppendStringAsUtf8(*Str, Str.Len(), outBinaryData);
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+﻿#include "MessageMangerStats.h"
+#include "HAL/PlatformTime.h"
+#include "Math/UnrealMathUtility.h"
+
+DEFINE_STAT(STAT_MessageMangerInboxDepth);
+
+FThroughputSnapshot FThroughputCounter::Snapshot() const
+{
+    FThroughputSnapshot Result;
+    Result.Messages = Messages.load(std::memory_order_relaxed);
+    Result.Bytes = Bytes.load(std::memory_order_relaxed);
+    Result.WriteCalls = WriteCalls.load(std::memory_order_relaxed);
+    Result.ElapsedSeconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles.load(std::memory_order_relaxed));
+    return Result;
+}
+
+void FThroughputCounter::Reset()
+{
+    Messages.store(0, std::memory_order_relaxed);
+    Bytes.store(0, std::memory_order_relaxed);
+    WriteCalls.store(0, std::memory_order_relaxed);
+    StartCycles.store(FPlatformTime::Cycles64(), std::memory_order_relaxed);
+}
+
+FCodecSnapshot FCodecCounter::Snapshot() const
+{
+    FCodecSnapshot Result;
+    Result.Messages = Messages.load(std::memory_order_relaxed);
+    Result.Bytes = Bytes.load(std::memory_order_relaxed);
+    Result.CpuSeconds = FPlatformTime::ToSeconds64(Cycles.load(std::memory_order_relaxed));
+    return Result;
+}
+
+void FCodecCounter::Reset()
+{
+    Messages.store(0, std::memory_order_relaxed);
+    Bytes.store(0, std::memory_order_relaxed);
+    Cycles.store(0, std::memory_order_relaxed);
+}
+
+FLatencyHistogram::FLatencyHistogram()
+{
+    Reset();
+}
+
+int32 FLatencyHistogram::BucketIndex(uint64 Micros)
+{
+    // 小于8微秒时每个值单独一个桶
+    if (Micros < SubBucketCount)
+    {
+        return (int32)Micros;
+    }
+
+    const int32 Exponent = (int32)FMath::FloorLog2_64(Micros);
+    const int32 SubBucket = (int32)((Micros >> (Exponent - SubBucketBits)) & (SubBucketCount - 1));
+    return (Exponent - SubBucketBits + 1) * SubBucketCount + SubBucket;
+}
+
+double FLatencyHistogram::BucketValue(int32 Index)
+{
+    if (Index < SubBucketCount)
+    {
+        return (double)Index;
+    }
+
+    // 返回桶区间的中点
+    const int32 Exponent = Index / SubBucketCount + SubBucketBits - 1;
+    const int32 SubBucket = Index % SubBucketCount;
+    const double Width = (double)(1ull << (Exponent - SubBucketBits));
+    const double Lower = (double)(SubBucketCount + SubBucket) * Width;
+    return Lower + Width * 0.5;
+}
+
+void FLatencyHistogram::AddSample(uint64 Micros)
+{
+    Buckets[BucketIndex(Micros)].fetch_add(1, std::memory_order_relaxed);
+    Count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64 PrevMax = Max.load(std::memory_order_relaxed);
+    while (Micros > PrevMax && !Max.compare_exchange_weak(PrevMax, Micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+void FLatencyHistogram::AddCycles(uint64 Cycles)
+{
+    AddSample((uint64)(FPlatformTime::ToSeconds64(Cycles) * 1000000.0));
+}
+
+FLatencySnapshot FLatencyHistogram::Snapshot() const
+{
+    FLatencySnapshot Result;
+    Result.SampleCount = Count.load(std::memory_order_relaxed);
+    Result.MaxMicros = (double)Max.load(std::memory_order_relaxed);
+    if (Result.SampleCount == 0)
+    {
+        return Result;
+    }
+
+    const uint64 P50Rank = (Result.SampleCount * 50 + 99) / 100;
+    const uint64 P99Rank = (Result.SampleCount * 99 + 99) / 100;
+    uint64 Seen = 0;
+    bool bFoundP50 = false;
+    for (int32 Index = 0; Index < NumBuckets; ++Index)
+    {
+        Seen += Buckets[Index].load(std::memory_order_relaxed);
+        if (!bFoundP50 && Seen >= P50Rank)
+        {
+            Result.P50Micros = FMath::Min(BucketValue(Index), Result.MaxMicros);
+            bFoundP50 = true;
+        }
+        if (Seen >= P99Rank)
+        {
+            Result.P99Micros = FMath::Min(BucketValue(Index), Result.MaxMicros);
+            break;
+        }
+    }
+    return Result;
+}
+
+void FLatencyHistogram::Reset()
+{
+    for (std::atomic<uint64>& Bucket : Buckets)
+    {
+        Bucket.store(0, std::memory_order_relaxed);
+    }
+    Count.store(0, std::memory_order_relaxed);
+    Max.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+﻿#include "MessageTypeRegistry.h"
+#include "Utf8Transcoder.h"
+
+uint16 FMessageTypeRegistry::MakeId(FUtf8StringView Name)
+{
+    uint32 Hash = FnvOffsetBasis;
+    for (const UTF8CHAR Char : Name)
+    {
+        Hash = (Hash ^ (uint8)Char) * FnvPrime;
+    }
+    return FoldHash(Hash);
+}
+
+uint16 FMessageTypeRegistry::MakeId(FStringView Name)
+{
+    uint32 Hash = FnvOffsetBasis;
+    for (int32 Index = 0; Index < Name.Len(); ++Index)
+    {
+        uint32 CodePoint = Name[Index];
+        if (CodePoint < 0x80)
+        {
+            Hash = (Hash ^ CodePoint) * FnvPrime;
+            continue;
+        }
+
+        // 非ASCII字符按UTF-8字节计算，与对端的哈希一致
+        if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && Index + 1 < Name.Len()
+            && Name[Index + 1] >= 0xDC00 && Name[Index + 1] <= 0xDFFF)
+        {
+            CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + ((uint32)Name[++Index] - 0xDC00);
+        }
+        uint8 Utf8[4];
+        const int32 Utf8Length = FUtf8Transcoder::EncodeCodePoint(CodePoint, Utf8);
+        for (int32 Byte = 0; Byte < Utf8Length; ++Byte)
+        {
+            Hash = (Hash ^ Utf8[Byte]) * FnvPrime;
+        }
+    }
+    return FoldHash(Hash);
+}
+
+FMessageTypeRegistry::FMessageTypeRegistry()
+{
+    IdToIndex.SetNumZeroed(65536);
+    Register(TEXT("Heartbeat"));
+}
+
+int32 FMessageTypeRegistry::Register(const FString& Name)
+{
+    const uint16 Id = MakeId(Name);
+    const int32 Existing = FindIndex(Id);
+    if (Existing != INDEX_NONE)
+    {
+        if (Names[Existing].Equals(Name, ESearchCase::CaseSensitive))
+        {
+            return Existing;
+        }
+        UE_LOG(LogTemp, Error, TEXT("Message type '%s' collides with '%s' (type id %u), rename one of them"), *Name, *Names[Existing], Id);
+        return INDEX_NONE;
+    }
+
+    if (Names.Num() >= MAX_uint16)
+    {
+        return INDEX_NONE;
+    }
+    const int32 Index = Names.Add(Name);
+    const FTCHARToUTF8 Utf8Name(*Name, Name.Len());
+    Utf8Names.Emplace(reinterpret_cast<const UTF8CHAR*>(Utf8Name.Get()), Utf8Name.Length());
+    IdToIndex[Id] = (uint16)(Index + 1);
+    return Index;
+}
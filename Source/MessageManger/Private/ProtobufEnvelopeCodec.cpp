@@ -0,0 +1,240 @@
+﻿#include "ProtobufEnvelopeCodec.h"
+#include "MessageMangerBPLibrary.h"
+
+#if WITH_PROTOBUF
+
+// protobuf/absl与UE的check/verify宏冲突
+#pragma push_macro("check")
+#pragma push_macro("verify")
+#undef check
+#undef verify
+THIRD_PARTY_INCLUDES_START
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+THIRD_PARTY_INCLUDES_END
+#pragma pop_macro("verify")
+#pragma pop_macro("check")
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+namespace NetworkEnvelopeFields
+{
+    constexpr int Type = 1;
+    constexpr int Payload = 2;
+    constexpr int Sequence = 3;
+    constexpr int CreatedUnixMicros = 4;
+    constexpr int SentUnixMicros = 5;
+    constexpr int CorrelationId = 6;
+    constexpr int IsResponse = 7;
+}
+
+namespace
+{
+    // 长度前缀字段（tag + 长度 + 内容）的编码大小
+    int32 LengthDelimitedSize(int FieldNumber, int32 Length)
+    {
+        if (Length == 0)
+        {
+            return 0;
+        }
+        return (int32)(CodedOutputStream::VarintSize32(WireFormatLite::MakeTag(FieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+            + CodedOutputStream::VarintSize32((uint32)Length) + Length);
+    }
+
+    // varint字段的编码大小，proto3中0值不写
+    int32 VarintFieldSize(int FieldNumber, uint64 Value)
+    {
+        if (Value == 0)
+        {
+            return 0;
+        }
+        return (int32)(CodedOutputStream::VarintSize32(WireFormatLite::MakeTag(FieldNumber, WireFormatLite::WIRETYPE_VARINT))
+            + CodedOutputStream::VarintSize64(Value));
+    }
+
+    uint8* WriteLengthDelimited(int FieldNumber, const void* Data, int32 Length, uint8* Target)
+    {
+        if (Length == 0)
+        {
+            return Target;
+        }
+        Target = WireFormatLite::WriteTagToArray(FieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, Target);
+        Target = CodedOutputStream::WriteVarint32ToArray((uint32)Length, Target);
+        return CodedOutputStream::WriteRawToArray(Data, Length, Target);
+    }
+
+    // 读取一个长度前缀字段，直接引用输入缓冲区
+    bool ReadLengthDelimited(CodedInputStream& Input, const uint8*& OutData, int32& OutLength)
+    {
+        uint32 Length = 0;
+        if (!Input.ReadVarint32(&Length))
+        {
+            return false;
+        }
+
+        const void* Buffer = nullptr;
+        int BufferSize = 0;
+        if (Length > 0 && (!Input.GetDirectBufferPointer(&Buffer, &BufferSize) || (uint32)BufferSize < Length))
+        {
+            return false;
+        }
+        OutData = static_cast<const uint8*>(Buffer);
+        OutLength = (int32)Length;
+        return Input.Skip((int)Length);
+    }
+}
+
+void FProtobufEnvelopeCodec::Encode(const FNetworkMessage& Message, TArray<uint8>& OutBytes)
+{
+    const FTCHARToUTF8 TypeUtf8(*Message.MessageType, Message.MessageType.Len());
+    const FTCHARToUTF8 PayloadUtf8(*Message.JsonData, Message.JsonData.Len());
+
+    const int32 EncodedSize = LengthDelimitedSize(NetworkEnvelopeFields::Type, TypeUtf8.Length())
+        + LengthDelimitedSize(NetworkEnvelopeFields::Payload, PayloadUtf8.Length())
+        + VarintFieldSize(NetworkEnvelopeFields::Sequence, (uint64)Message.Sequence)
+        + VarintFieldSize(NetworkEnvelopeFields::CreatedUnixMicros, (uint64)Message.CreatedUnixMicros)
+        + VarintFieldSize(NetworkEnvelopeFields::SentUnixMicros, (uint64)Message.SentUnixMicros)
+        + VarintFieldSize(NetworkEnvelopeFields::CorrelationId, (uint64)Message.CorrelationId)
+        + VarintFieldSize(NetworkEnvelopeFields::IsResponse, Message.bIsResponse ? 1 : 0);
+
+    // 一次算出大小后直接写入目标数组，不经过中间缓冲区
+    const int32 StartOffset = OutBytes.Num();
+    OutBytes.AddUninitialized(EncodedSize);
+    uint8* Target = OutBytes.GetData() + StartOffset;
+
+    Target = WriteLengthDelimited(NetworkEnvelopeFields::Type, TypeUtf8.Get(), TypeUtf8.Length(), Target);
+    Target = WriteLengthDelimited(NetworkEnvelopeFields::Payload, PayloadUtf8.Get(), PayloadUtf8.Length(), Target);
+    if (Message.Sequence != 0)
+    {
+        Target = WireFormatLite::WriteUInt64ToArray(NetworkEnvelopeFields::Sequence, (uint64)Message.Sequence, Target);
+    }
+    if (Message.CreatedUnixMicros != 0)
+    {
+        Target = WireFormatLite::WriteInt64ToArray(NetworkEnvelopeFields::CreatedUnixMicros, Message.CreatedUnixMicros, Target);
+    }
+    if (Message.SentUnixMicros != 0)
+    {
+        Target = WireFormatLite::WriteInt64ToArray(NetworkEnvelopeFields::SentUnixMicros, Message.SentUnixMicros, Target);
+    }
+    if (Message.CorrelationId != 0)
+    {
+        Target = WireFormatLite::WriteUInt64ToArray(NetworkEnvelopeFields::CorrelationId, (uint64)Message.CorrelationId, Target);
+    }
+    if (Message.bIsResponse)
+    {
+        Target = WireFormatLite::WriteBoolToArray(NetworkEnvelopeFields::IsResponse, true, Target);
+    }
+
+    checkSlow(Target == OutBytes.GetData() + OutBytes.Num());
+}
+
+bool FProtobufEnvelopeCodec::Decode(const uint8* Data, int32 Length, FNetworkMessage& OutMessage)
+{
+    CodedInputStream Input(Data, Length);
+
+    while (const uint32 Tag = Input.ReadTag())
+    {
+        const int FieldNumber = WireFormatLite::GetTagFieldNumber(Tag);
+        const WireFormatLite::WireType WireType = WireFormatLite::GetTagWireType(Tag);
+
+        if ((FieldNumber == NetworkEnvelopeFields::Type || FieldNumber == NetworkEnvelopeFields::Payload)
+            && WireType == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+        {
+            const uint8* FieldData = nullptr;
+            int32 FieldLength = 0;
+            if (!ReadLengthDelimited(Input, FieldData, FieldLength))
+            {
+                return false;
+            }
+            FString& Target = (FieldNumber == NetworkEnvelopeFields::Type) ? OutMessage.MessageType : OutMessage.JsonData;
+            Target = UMessageMangerBPLibrary::ConvertUtf8BinaryToString(FieldData, FieldLength);
+        }
+        else if ((FieldNumber == NetworkEnvelopeFields::Sequence || FieldNumber == NetworkEnvelopeFields::CreatedUnixMicros
+            || FieldNumber == NetworkEnvelopeFields::SentUnixMicros || FieldNumber == NetworkEnvelopeFields::CorrelationId
+            || FieldNumber == NetworkEnvelopeFields::IsResponse) && WireType == WireFormatLite::WIRETYPE_VARINT)
+        {
+            uint64 Value = 0;
+            if (!Input.ReadVarint64(&Value))
+            {
+                return false;
+            }
+            if (FieldNumber == NetworkEnvelopeFields::Sequence)
+            {
+                OutMessage.Sequence = (int64)Value;
+            }
+            else if (FieldNumber == NetworkEnvelopeFields::CreatedUnixMicros)
+            {
+                OutMessage.CreatedUnixMicros = (int64)Value;
+            }
+            else if (FieldNumber == NetworkEnvelopeFields::SentUnixMicros)
+            {
+                OutMessage.SentUnixMicros = (int64)Value;
+            }
+            else if (FieldNumber == NetworkEnvelopeFields::CorrelationId)
+            {
+                OutMessage.CorrelationId = (int64)Value;
+            }
+            else
+            {
+                OutMessage.bIsResponse = Value != 0;
+            }
+        }
+        else
+        {
+            // 未知字段按线格式跳过，保持向前兼容
+            if (!WireFormatLite::SkipField(&Input, Tag))
+            {
+                return false;
+            }
+        }
+    }
+
+    // ReadTag返回0时可能是到达末尾，也可能是非法tag
+    return Input.ConsumedEntireMessage();
+}
+
+bool FProtobufEnvelopeCodec::FindPayload(const uint8* Data, int32 Length, const uint8*& OutPayload, int32& OutLength)
+{
+    CodedInputStream Input(Data, Length);
+    OutPayload = Data;
+    OutLength = 0;
+
+    while (const uint32 Tag = Input.ReadTag())
+    {
+        // 重复的字段以最后一次为准，与Decode一致
+        if (WireFormatLite::GetTagFieldNumber(Tag) == NetworkEnvelopeFields::Payload
+            && WireFormatLite::GetTagWireType(Tag) == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+        {
+            if (!ReadLengthDelimited(Input, OutPayload, OutLength))
+            {
+                return false;
+            }
+        }
+        else if (!WireFormatLite::SkipField(&Input, Tag))
+        {
+            return false;
+        }
+    }
+    return Input.ConsumedEntireMessage();
+}
+
+#else
+
+void FProtobufEnvelopeCodec::Encode(const FNetworkMessage& Message, TArray<uint8>& OutBytes)
+{
+    UE_LOG(LogTemp, Error, TEXT("Protobuf envelope codec is not available on this platform"));
+}
+
+bool FProtobufEnvelopeCodec::Decode(const uint8* Data, int32 Length, FNetworkMessage& OutMessage)
+{
+    return false;
+}
+
+bool FProtobufEnvelopeCodec::FindPayload(const uint8* Data, int32 Length, const uint8*& OutPayload, int32& OutLength)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,170 @@
+﻿#include "RpcCallTable.h"
+#include "Misc/ScopeLock.h"
+
+void FRpcCallTable::FCompletion::SetResult(FRpcResult&& Result)
+{
+    if (Waiter)
+    {
+        Waiter->OnRpcComplete(MoveTemp(Result));
+    }
+    else if (Promise.IsSet())
+    {
+        Promise->SetValue(MoveTemp(Result));
+    }
+}
+
+FRpcCallTable::FRpcCallTable()
+    : Capacity(4096)
+    , EarliestDeadline(MAX_uint64)
+    , NumPending(0)
+{
+}
+
+void FRpcCallTable::SetCapacity(int32 InCapacity)
+{
+    FScopeLock ScopeLock(&Lock);
+    Capacity = FMath::Clamp(InCapacity, 1, MaxCapacity);
+}
+
+int32 FRpcCallTable::AllocateLocked(uint64 DeadlineCycles)
+{
+    int32 Index;
+    if (FreeSlots.Num() > 0)
+    {
+        Index = FreeSlots.Pop(EAllowShrinking::No);
+    }
+    else if (Slots.Num() < Capacity)
+    {
+        Index = Slots.AddDefaulted();
+    }
+    else
+    {
+        return INDEX_NONE;
+    }
+
+    FSlot& Slot = Slots[Index];
+    ++Slot.Generation;
+    Slot.DeadlineCycles = DeadlineCycles;
+    EarliestDeadline = FMath::Min(EarliestDeadline, DeadlineCycles);
+    NumPending.fetch_add(1, std::memory_order_relaxed);
+    return Index;
+}
+
+uint64 FRpcCallTable::MakeCorrelationIdLocked(int32 Index) const
+{
+    return ((uint64)Slots[Index].Generation << IndexBits) | (uint64)(Index + 1);
+}
+
+uint64 FRpcCallTable::Add(uint64 DeadlineCycles, TFuture<FRpcResult>& OutFuture)
+{
+    FScopeLock ScopeLock(&Lock);
+    const int32 Index = AllocateLocked(DeadlineCycles);
+    if (Index == INDEX_NONE)
+    {
+        return 0;
+    }
+
+    FCompletion& Completion = Slots[Index].Completion;
+    Completion.Promise.Emplace();
+    OutFuture = Completion.Promise->GetFuture();
+    return MakeCorrelationIdLocked(Index);
+}
+
+uint64 FRpcCallTable::Add(uint64 DeadlineCycles, FRpcWaiter& Waiter)
+{
+    FScopeLock ScopeLock(&Lock);
+    const int32 Index = AllocateLocked(DeadlineCycles);
+    if (Index == INDEX_NONE)
+    {
+        return 0;
+    }
+
+    Slots[Index].Completion.Waiter = &Waiter;
+    return MakeCorrelationIdLocked(Index);
+}
+
+FRpcCallTable::FCompletion FRpcCallTable::ReleaseLocked(int32 Index)
+{
+    FCompletion Completion = MoveTemp(Slots[Index].Completion);
+    Slots[Index].Completion = FCompletion();
+    FreeSlots.Add(Index);
+    NumPending.fetch_sub(1, std::memory_order_relaxed);
+    return Completion;
+}
+
+bool FRpcCallTable::Complete(uint64 CorrelationId, FRpcResult&& Result)
+{
+    const int32 Index = (int32)(CorrelationId & IndexMask) - 1;
+    const uint32 Generation = (uint32)(CorrelationId >> IndexBits);
+
+    FCompletion Completion;
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (!Slots.IsValidIndex(Index) || !Slots[Index].Completion.IsSet() || Slots[Index].Generation != Generation)
+        {
+            return false;
+        }
+        Completion = ReleaseLocked(Index);
+    }
+
+    // 在锁外完成，回调中可以发起新的调用
+    Completion.SetResult(MoveTemp(Result));
+    return true;
+}
+
+int32 FRpcCallTable::ExpireDeadlines(uint64 NowCycles)
+{
+    TArray<FCompletion, TInlineAllocator<16>> Expired;
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (NowCycles < EarliestDeadline)
+        {
+            return 0;
+        }
+
+        EarliestDeadline = MAX_uint64;
+        for (int32 Index = 0; Index < Slots.Num(); ++Index)
+        {
+            const FSlot& Slot = Slots[Index];
+            if (!Slot.Completion.IsSet())
+            {
+                continue;
+            }
+            if (Slot.DeadlineCycles <= NowCycles)
+            {
+                Expired.Add(ReleaseLocked(Index));
+            }
+            else
+            {
+                EarliestDeadline = FMath::Min(EarliestDeadline, Slot.DeadlineCycles);
+            }
+        }
+    }
+
+    for (FCompletion& Completion : Expired)
+    {
+        Completion.SetResult(FRpcResult{ ERpcStatus::Timeout });
+    }
+    return Expired.Num();
+}
+
+void FRpcCallTable::FailAll(ERpcStatus Status)
+{
+    TArray<FCompletion> Failed;
+    {
+        FScopeLock ScopeLock(&Lock);
+        for (int32 Index = 0; Index < Slots.Num(); ++Index)
+        {
+            if (Slots[Index].Completion.IsSet())
+            {
+                Failed.Add(ReleaseLocked(Index));
+            }
+        }
+        EarliestDeadline = MAX_uint64;
+    }
+
+    for (FCompletion& Completion : Failed)
+    {
+        Completion.SetResult(FRpcResult{ Status });
+    }
+}
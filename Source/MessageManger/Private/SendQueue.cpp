@@ -0,0 +1,254 @@
+﻿#include "SendQueue.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/Event.h"
+#include "Misc/ScopeLock.h"
+
+FSendQueue::FSendQueue()
+    : QueuedMessages(0)
+    , QueuedBytes(0)
+    , bClosed(false)
+    , bAboveHighWatermark(false)
+    , SpaceAvailableEvent(FPlatformProcess::GetSynchEventFromPool(false))
+    , BlockedProducers(0)
+    , DroppedCount(0)
+{
+}
+
+FSendQueue::~FSendQueue()
+{
+    FPlatformProcess::ReturnSynchEventToPool(SpaceAvailableEvent);
+    SpaceAvailableEvent = nullptr;
+}
+
+bool FSendQueue::IsFull(int64 IncomingBytes) const
+{
+    if (Limits.MaxMessages > 0 && QueuedMessages >= Limits.MaxMessages)
+    {
+        return true;
+    }
+
+    // 队列为空时总是接受一条消息，避免单条超大消息永远无法发送
+    if (Limits.MaxBytes > 0 && QueuedMessages > 0 && QueuedBytes + IncomingBytes > Limits.MaxBytes)
+    {
+        return true;
+    }
+    return false;
+}
+
+bool FSendQueue::UpdateWatermark(bool& bOutAboveHigh)
+{
+    double FillRatio = 0.0;
+    if (Limits.MaxMessages > 0)
+    {
+        FillRatio = FMath::Max(FillRatio, (double)QueuedMessages / Limits.MaxMessages);
+    }
+    if (Limits.MaxBytes > 0)
+    {
+        FillRatio = FMath::Max(FillRatio, (double)QueuedBytes / Limits.MaxBytes);
+    }
+
+    if (!bAboveHighWatermark && FillRatio >= Limits.HighWatermark && (Limits.MaxMessages > 0 || Limits.MaxBytes > 0))
+    {
+        bAboveHighWatermark = true;
+        bOutAboveHigh = true;
+        return true;
+    }
+    if (bAboveHighWatermark && FillRatio <= Limits.LowWatermark)
+    {
+        bAboveHighWatermark = false;
+        bOutAboveHigh = false;
+        return true;
+    }
+    return false;
+}
+
+void FSendQueue::PopFirstLocked(int32 Lane, FQueuedMessage* OutMessage)
+{
+    FQueuedMessage& Front = Lanes[Lane].First();
+    QueuedBytes -= Front.SizeBytes;
+    --QueuedMessages;
+    if (OutMessage)
+    {
+        *OutMessage = MoveTemp(Front);
+    }
+    Lanes[Lane].PopFirst();
+}
+
+bool FSendQueue::DropOldestLocked(int32 IncomingLane)
+{
+    for (int32 Lane = NumLanes - 1; Lane >= IncomingLane; --Lane)
+    {
+        if (!Lanes[Lane].IsEmpty())
+        {
+            PopFirstLocked(Lane, nullptr);
+            DroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+FSendQueue::EEnqueueResult FSendQueue::Enqueue(FQueuedMessage&& Message, bool& bOutWasEmpty)
+{
+    bOutWasEmpty = false;
+
+    const int32 Lane = GetLane(Message.Message);
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    bool bDroppedOldest = false;
+    bool bNotifyWatermark = false;
+    bool bAboveHigh = false;
+
+    for (;;)
+    {
+        {
+            FScopeLock ScopeLock(&Lock);
+            if (bClosed)
+            {
+                return EEnqueueResult::Closed;
+            }
+
+            if (IsFull(Message.SizeBytes))
+            {
+                switch (Limits.OverflowPolicy)
+                {
+                case ESendQueueOverflowPolicy::DropOldest:
+                    // 从低优先级通道开始丢弃最旧的消息直到放得下
+                    while (IsFull(Message.SizeBytes) && DropOldestLocked(Lane))
+                    {
+                        bDroppedOldest = true;
+                    }
+                    if (IsFull(Message.SizeBytes))
+                    {
+                        // 队列中只剩更高优先级的消息，丢弃新消息
+                        DroppedCount.fetch_add(1, std::memory_order_relaxed);
+                        return EEnqueueResult::DroppedNewest;
+                    }
+                    break;
+
+                case ESendQueueOverflowPolicy::Block:
+                    break;
+
+                case ESendQueueOverflowPolicy::DropNewest:
+                    DroppedCount.fetch_add(1, std::memory_order_relaxed);
+                    return EEnqueueResult::DroppedNewest;
+
+                case ESendQueueOverflowPolicy::FailFast:
+                default:
+                    DroppedCount.fetch_add(1, std::memory_order_relaxed);
+                    return EEnqueueResult::Rejected;
+                }
+            }
+
+            if (!IsFull(Message.SizeBytes))
+            {
+                bOutWasEmpty = (QueuedMessages == 0);
+                QueuedBytes += Message.SizeBytes;
+                ++QueuedMessages;
+                Lanes[Lane].PushLast(MoveTemp(Message));
+                bNotifyWatermark = UpdateWatermark(bAboveHigh);
+                break;
+            }
+
+            // 在持有锁时登记，保证出队线程能看到等待者
+            BlockedProducers.fetch_add(1);
+        }
+
+        // Block策略：在锁外等待发送线程腾出空间
+        const double ElapsedMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+        if (ElapsedMs < Limits.BlockTimeoutMs)
+        {
+            SpaceAvailableEvent->Wait((uint32)FMath::CeilToInt(Limits.BlockTimeoutMs - ElapsedMs));
+        }
+        BlockedProducers.fetch_sub(1);
+
+        if (ElapsedMs >= Limits.BlockTimeoutMs)
+        {
+            DroppedCount.fetch_add(1, std::memory_order_relaxed);
+            return EEnqueueResult::Rejected;
+        }
+    }
+
+    if (bNotifyWatermark && WatermarkCallback)
+    {
+        WatermarkCallback(bAboveHigh);
+    }
+    return bDroppedOldest ? EEnqueueResult::QueuedDroppedOldest : EEnqueueResult::Queued;
+}
+
+bool FSendQueue::Dequeue(FQueuedMessage& OutMessage, int32 LaneLimit)
+{
+    bool bNotifyWatermark = false;
+    bool bAboveHigh = false;
+    {
+        FScopeLock ScopeLock(&Lock);
+        int32 Lane = 0;
+        const int32 EndLane = FMath::Min(LaneLimit, NumLanes);
+        while (Lane < EndLane && Lanes[Lane].IsEmpty())
+        {
+            ++Lane;
+        }
+        if (Lane >= EndLane)
+        {
+            return false;
+        }
+        PopFirstLocked(Lane, &OutMessage);
+        bNotifyWatermark = UpdateWatermark(bAboveHigh);
+    }
+
+    // 唤醒一个等待空间的生产者
+    if (BlockedProducers.load() > 0)
+    {
+        SpaceAvailableEvent->Trigger();
+    }
+
+    if (bNotifyWatermark && WatermarkCallback)
+    {
+        WatermarkCallback(bAboveHigh);
+    }
+    return true;
+}
+
+void FSendQueue::Open()
+{
+    FScopeLock ScopeLock(&Lock);
+    bClosed = false;
+}
+
+void FSendQueue::Close()
+{
+    {
+        FScopeLock ScopeLock(&Lock);
+        bClosed = true;
+    }
+
+    // 唤醒所有阻塞的生产者
+    for (int32 Index = BlockedProducers.load(); Index > 0; --Index)
+    {
+        SpaceAvailableEvent->Trigger();
+    }
+}
+
+void FSendQueue::Reset()
+{
+    FScopeLock ScopeLock(&Lock);
+    for (TDeque<FQueuedMessage>& LaneMessages : Lanes)
+    {
+        LaneMessages.Empty();
+    }
+    QueuedMessages = 0;
+    QueuedBytes = 0;
+    bAboveHighWatermark = false;
+}
+
+int32 FSendQueue::Num() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return QueuedMessages;
+}
+
+int64 FSendQueue::NumBytes() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return QueuedBytes;
+}
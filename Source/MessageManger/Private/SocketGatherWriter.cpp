@@ -0,0 +1,330 @@
+﻿#include "SocketGatherWriter.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+#ifndef WITH_SOCKET_GATHER_SEND
+#define WITH_SOCKET_GATHER_SEND 0
+#endif
+
+#if WITH_SOCKET_GATHER_SEND
+#include "BSDSockets/SocketsBSD.h"
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
+
+// 旧版本sysroot中可能缺少零拷贝相关定义
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+// 没有定义_GNU_SOURCE/_XOPEN_SOURCE时limits.h不提供IOV_MAX，Linux上的值为1024
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#endif
+
+int32 FSocketGatherWriter::GetMaxChunksPerWrite()
+{
+#if WITH_SOCKET_GATHER_SEND
+    return IOV_MAX / 2;
+#else
+    // 退化路径打包到暂存缓冲区后一次Send，按常见的IOV_MAX（1024）计算
+    return 512;
+#endif
+}
+
+FSocketGatherWriter::FSocketGatherWriter(FSocket& InSocket, int32 InZeroCopyThreshold)
+    : Socket(InSocket)
+    , PendingPayloadBytes(0)
+    , PendingBytes(0)
+    , SentBytes(0)
+    , FirstUnsentChunk(0)
+    , FirstUnsentOffset(0)
+    , StagedOffset(0)
+    , StagedChunkEnd(0)
+    , ZeroCopyThreshold(0)
+    , NextZeroCopySequence(0)
+    , ZeroCopyCallsInBatch(0)
+    , WriteCalls(0)
+    , NativeSocket(-1)
+{
+#if WITH_SOCKET_GATHER_SEND
+    NativeSocket = (int32)static_cast<FSocketBSD&>(Socket).GetNativeSocket();
+
+    if (InZeroCopyThreshold > 0)
+    {
+        int32 Enable = 1;
+        if (setsockopt(NativeSocket, SOL_SOCKET, SO_ZEROCOPY, &Enable, sizeof(Enable)) == 0)
+        {
+            ZeroCopyThreshold = InZeroCopyThreshold;
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("SO_ZEROCOPY not supported (errno %d), using copying sends"), errno);
+        }
+    }
+#endif
+}
+
+FSocketGatherWriter::~FSocketGatherWriter()
+{
+    // 内核可能仍在读取零拷贝负载，此时Socket已关闭，释放引用即可
+    ZeroCopyPending.Empty();
+}
+
+void FSocketGatherWriter::AddChunk(const FChunkHeader& Header, const FMessageBufferRef& Payload, int32 Offset, int32 Size)
+{
+    check(Offset >= 0 && Size >= 0 && Offset + Size <= Payload->Num());
+    // 零拷贝发送中的头部数组不能再增长，否则内核引用的地址会失效
+    checkf(ZeroCopyCallsInBatch == 0, TEXT("Cannot append chunks while a zero-copy batch is in flight"));
+
+    const int32 HeaderIndex = Headers.Add(Header);
+    Chunks.Add(FChunkSegment{ HeaderIndex, Payload->GetData() + Offset, Size });
+
+    // 同一负载的连续分片只保留一次引用
+    if (HeldPayloads.Num() == 0 || &HeldPayloads.Last().Get() != &Payload.Get())
+    {
+        HeldPayloads.Add(Payload);
+    }
+
+    PendingPayloadBytes += Size;
+    PendingBytes += MessageProtocol::HeaderSize + Size;
+}
+
+FSocketGatherWriter::EFlushResult FSocketGatherWriter::Flush()
+{
+    if (Chunks.Num() == 0)
+    {
+        return EFlushResult::Complete;
+    }
+
+    EFlushResult Result;
+#if WITH_SOCKET_GATHER_SEND
+    ReapZeroCopyCompletions();
+    Result = FlushGather(ZeroCopyThreshold > 0 && PendingPayloadBytes >= ZeroCopyThreshold);
+#else
+    Result = FlushStaged();
+#endif
+
+    // 只有全部写出后才清空，WouldBlock时保留断点
+    if (Result == EFlushResult::Complete)
+    {
+        ResetBatch();
+    }
+    return Result;
+}
+
+void FSocketGatherWriter::ResetBatch()
+{
+    Headers.Reset();
+    Chunks.Reset();
+    HeldPayloads.Reset();
+    PendingPayloadBytes = 0;
+    PendingBytes = 0;
+    SentBytes = 0;
+    FirstUnsentChunk = 0;
+    FirstUnsentOffset = 0;
+    StagingBuffer.Reset();
+    StagedOffset = 0;
+    StagedChunkEnd = 0;
+    ZeroCopyCallsInBatch = 0;
+}
+
+FSocketGatherWriter::EFlushResult FSocketGatherWriter::FlushStaged()
+{
+    for (;;)
+    {
+        if (StagedOffset == StagingBuffer.Num())
+        {
+            // 暂存区已写完，打包剩余的分片（暂存缓冲区只增长不收缩，稳定后不再分配）
+            if (StagedChunkEnd == Chunks.Num())
+            {
+                return EFlushResult::Complete;
+            }
+
+            StagingBuffer.Reset();
+            for (int32 Index = StagedChunkEnd; Index < Chunks.Num(); ++Index)
+            {
+                const FChunkSegment& Chunk = Chunks[Index];
+                StagingBuffer.Append(reinterpret_cast<const uint8*>(&Headers[Chunk.HeaderIndex]), MessageProtocol::HeaderSize);
+                StagingBuffer.Append(Chunk.Payload, Chunk.PayloadSize);
+            }
+            StagedOffset = 0;
+            StagedChunkEnd = Chunks.Num();
+        }
+
+        const int32 Remaining = StagingBuffer.Num() - StagedOffset;
+        int32 BytesSent = 0;
+        if (!Socket.Send(StagingBuffer.GetData() + StagedOffset, Remaining, BytesSent))
+        {
+            const ESocketErrors LastError = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode();
+            if (LastError == SE_EWOULDBLOCK)
+            {
+                return EFlushResult::WouldBlock;
+            }
+
+            UE_LOG(LogTemp, Error, TEXT("Failed to send %d chunks. Sent %d of %d bytes (error %d)"),
+                Chunks.Num(), SentBytes, PendingBytes, (int32)LastError);
+            return EFlushResult::Error;
+        }
+
+        ++WriteCalls;
+        StagedOffset += BytesSent;
+        SentBytes += BytesSent;
+        if (BytesSent < Remaining)
+        {
+            // 部分写入：内核发送缓冲区已满
+            return EFlushResult::WouldBlock;
+        }
+    }
+}
+
+#if WITH_SOCKET_GATHER_SEND
+
+FSocketGatherWriter::EFlushResult FSocketGatherWriter::FlushGather(bool bZeroCopy)
+{
+    // 每个分片占用两个iovec（头部 + 负载）
+    const int32 MaxChunksPerCall = GetMaxChunksPerWrite();
+    iovec IoVecs[IOV_MAX];
+
+    while (FirstUnsentChunk < Chunks.Num())
+    {
+        // 从断点开始组装iovec
+        int32 NumIoVecs = 0;
+        const int32 LastChunk = FMath::Min(Chunks.Num(), FirstUnsentChunk + MaxChunksPerCall);
+        for (int32 Index = FirstUnsentChunk; Index < LastChunk; ++Index)
+        {
+            const FChunkSegment& Chunk = Chunks[Index];
+            const int32 SkipBytes = (Index == FirstUnsentChunk) ? FirstUnsentOffset : 0;
+            if (SkipBytes < MessageProtocol::HeaderSize)
+            {
+                IoVecs[NumIoVecs].iov_base = reinterpret_cast<uint8*>(&Headers[Chunk.HeaderIndex]) + SkipBytes;
+                IoVecs[NumIoVecs].iov_len = MessageProtocol::HeaderSize - SkipBytes;
+                ++NumIoVecs;
+            }
+            const int32 PayloadSkip = FMath::Max(0, SkipBytes - MessageProtocol::HeaderSize);
+            if (Chunk.PayloadSize > PayloadSkip)
+            {
+                IoVecs[NumIoVecs].iov_base = const_cast<uint8*>(Chunk.Payload) + PayloadSkip;
+                IoVecs[NumIoVecs].iov_len = Chunk.PayloadSize - PayloadSkip;
+                ++NumIoVecs;
+            }
+        }
+
+        msghdr Message = {};
+        Message.msg_iov = IoVecs;
+        Message.msg_iovlen = NumIoVecs;
+
+        const ssize_t BytesSent = sendmsg(NativeSocket, &Message, MSG_NOSIGNAL | (bZeroCopy ? MSG_ZEROCOPY : 0));
+        if (BytesSent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ENOBUFS && bZeroCopy)
+            {
+                // 零拷贝的锁定内存已用尽，本批次剩余部分退回普通发送
+                bZeroCopy = false;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return EFlushResult::WouldBlock;
+            }
+
+            UE_LOG(LogTemp, Error, TEXT("Failed to send %d chunks. Sent %d of %d bytes (errno %d)"),
+                Chunks.Num(), SentBytes, PendingBytes, errno);
+            return EFlushResult::Error;
+        }
+
+        ++WriteCalls;
+        if (bZeroCopy)
+        {
+            ++ZeroCopyCallsInBatch;
+        }
+
+        // 按写出的字节数推进断点
+        SentBytes += (int32)BytesSent;
+        int64 Advance = BytesSent;
+        while (Advance > 0)
+        {
+            const int32 ChunkBytes = MessageProtocol::HeaderSize + Chunks[FirstUnsentChunk].PayloadSize;
+            const int32 ChunkRemaining = ChunkBytes - FirstUnsentOffset;
+            if (Advance >= ChunkRemaining)
+            {
+                Advance -= ChunkRemaining;
+                ++FirstUnsentChunk;
+                FirstUnsentOffset = 0;
+            }
+            else
+            {
+                FirstUnsentOffset += (int32)Advance;
+                Advance = 0;
+            }
+        }
+    }
+
+    if (ZeroCopyCallsInBatch > 0)
+    {
+        // 内核按sendmsg调用次数递增序号，负载和头部保留到完成通知
+        NextZeroCopySequence += ZeroCopyCallsInBatch;
+        ZeroCopyPending.Add(FZeroCopyPending{ NextZeroCopySequence - 1, MoveTemp(Headers), MoveTemp(HeldPayloads) });
+    }
+    return EFlushResult::Complete;
+}
+
+void FSocketGatherWriter::ReapZeroCopyCompletions()
+{
+    while (ZeroCopyPending.Num() > 0)
+    {
+        uint8 Control[CMSG_SPACE(sizeof(sock_extended_err))];
+        msghdr Message = {};
+        Message.msg_control = Control;
+        Message.msg_controllen = sizeof(Control);
+
+        if (recvmsg(NativeSocket, &Message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            // EAGAIN：暂时没有新的完成通知
+            return;
+        }
+
+        for (cmsghdr* Cmsg = CMSG_FIRSTHDR(&Message); Cmsg; Cmsg = CMSG_NXTHDR(&Message, Cmsg))
+        {
+            const sock_extended_err* Err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(Cmsg));
+            if (Err->ee_errno != 0 || Err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+
+            // [ee_info, ee_data] 区间内的发送已完成，释放对应的缓冲区
+            const uint32 LastCompleted = Err->ee_data;
+            int32 NumCompleted = 0;
+            while (NumCompleted < ZeroCopyPending.Num() && (int32)(ZeroCopyPending[NumCompleted].Sequence - LastCompleted) <= 0)
+            {
+                ++NumCompleted;
+            }
+            ZeroCopyPending.RemoveAt(0, NumCompleted, EAllowShrinking::No);
+        }
+    }
+}
+
+#else
+
+FSocketGatherWriter::EFlushResult FSocketGatherWriter::FlushGather(bool bZeroCopy)
+{
+    return FlushStaged();
+}
+
+void FSocketGatherWriter::ReapZeroCopyCompletions()
+{
+}
+
+#endif
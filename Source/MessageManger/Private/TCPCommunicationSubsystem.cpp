@@ -3,22 +3,107 @@
 #include "Misc/FileHelper.h"
 #include "HAL/PlatformProcess.h"
 #include "TimerManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Optional.h"
+#include "Async/Async.h"
+#include "Misc/ScopeRWLock.h"
+#include "Tasks/Task.h"
 #include "EndianConverter.h"
+#include "FrameDecoder.h"
+#include "SocketGatherWriter.h"
+#include "ProtobufEnvelopeCodec.h"
+#include "JsonStreamWriter.h"
+#include "Hash/CityHash.h"
 #include <MessageMangerBPLibrary.h>
 
+DECLARE_CYCLE_STAT(TEXT("Drain Inbox"), STAT_MessageMangerDrainInbox, STATGROUP_MessageManger);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Inbox Messages Dispatched"), STAT_MessageMangerInboxDispatched, STATGROUP_MessageManger);
+
+namespace
+{
+    // 对象中键字段的原始JSON文本的哈希，数字和字符串形式的同一个值视为不同的键
+    bool HashJsonObjectField(const FJsonOnDemandValue& Object, FUtf8StringView KeyField, uint64& OutKey)
+    {
+        const FJsonOnDemandValue Value = Object.FindField(KeyField);
+        if (!Value.IsValid())
+        {
+            return false;
+        }
+        const FUtf8StringView RawJson = Value.GetRawJson();
+        OutKey = CityHash64(reinterpret_cast<const char*>(RawJson.GetData()), (uint32)RawJson.Len());
+        return true;
+    }
+
+    // 解析UTF-8的JSON文本后取键字段，Document复用内部数组
+    bool HashJsonTextField(FJsonOnDemandDocument& Document, const uint8* Data, int32 Length, FUtf8StringView KeyField, uint64& OutKey)
+    {
+        return Document.Parse(Data, Length) && HashJsonObjectField(Document.GetRoot(), KeyField, OutKey);
+    }
+}
+
 
 void UTCPCommunicationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
     Super::Initialize(Collection);
     bIsConnected = false;
+    ActiveCodec = ENetworkMessageCodec::Json;
     Socket = nullptr;
-    ReceiveTask = nullptr;
-    SendTask = nullptr;
+    ReceiveWorker = nullptr;
+    ReceiveThread = nullptr;
+    SendWorker = nullptr;
+    SendThread = nullptr;
+    bFlushRequested = false;
+    SendEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    DecodePipeline.SetDecodeFunction([this](FInboxEntry& Entry) { DecodeInboxEntry(Entry); });
+
+    // 收件箱Tick需要World，注册失败时RPC调用也必须能超时，所以截止时间由核心Ticker检查
+    RpcDeadlineTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UTCPCommunicationSubsystem::ExpireRpcDeadlines));
+
+    // 子系统跨地图存在，收件箱Tick跟随本游戏实例当前的World重新注册，没有World时由核心Ticker分发
+    PostWorldInitializationHandle = FWorldDelegates::OnPostWorldInitialization.AddUObject(this, &UTCPCommunicationSubsystem::HandlePostWorldInitialization);
+    WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UTCPCommunicationSubsystem::HandleWorldCleanup);
+    InboxFallbackTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UTCPCommunicationSubsystem::DrainInboxWithoutWorld));
+
+    // 水位变化可能发生在任意入队/出队线程上，转到游戏线程通知
+    SendQueue.SetWatermarkCallback([this](bool bAboveHighWatermark)
+    {
+        AsyncTask(ENamedThreads::GameThread, [this, bAboveHighWatermark]()
+        {
+            if (bAboveHighWatermark)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("Send queue above high watermark (%d messages queued)"), SendQueue.Num());
+            }
+            if (SendQueueWatermarkDelegate.IsBound())
+            {
+                SendQueueWatermarkDelegate.Execute(bAboveHighWatermark);
+            }
+        });
+    });
 }
 
 void UTCPCommunicationSubsystem::Deinitialize()
 {
     Disconnect();
+    FTSTicker::GetCoreTicker().RemoveTicker(RpcDeadlineTickerHandle);
+    RpcDeadlineTickerHandle.Reset();
+    FTSTicker::GetCoreTicker().RemoveTicker(InboxFallbackTickerHandle);
+    InboxFallbackTickerHandle.Reset();
+    FWorldDelegates::OnPostWorldInitialization.Remove(PostWorldInitializationHandle);
+    PostWorldInitializationHandle.Reset();
+    FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupHandle);
+    WorldCleanupHandle.Reset();
+    InboxTickFunction.UnRegisterTickFunction();
+    InboxTickFunction.Subsystem = nullptr;
+    InboxTickWorld.Reset();
+    Inbox.Empty();
+    SET_DWORD_STAT(STAT_MessageMangerInboxDepth, 0);
+    {
+        FWriteScopeLock Lock(WorkerSubscribersLock);
+        WorkerSubscribers.Reset();
+    }
+    SendQueue.SetWatermarkCallback(nullptr);
+    FPlatformProcess::ReturnSynchEventToPool(SendEvent);
+    SendEvent = nullptr;
     Super::Deinitialize();
 }
 
@@ -29,6 +114,13 @@ bool UTCPCommunicationSubsystem::Connect(const FString& InIPAddress, int32 InPor
     {
         Disconnect();
     }
+
+    // 没有附带protobuf库的平台不能收发protobuf信封
+    if (Settings.MessageCodec == ENetworkMessageCodec::Protobuf && !FProtobufEnvelopeCodec::IsAvailable())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Protobuf message codec is not available on this platform"));
+        return false;
+    }
     ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get();
     // 创建Socket
     Socket = MakeShareable(SocketSubsystem->CreateSocket(NAME_Stream, TEXT("Default"), false));
@@ -63,11 +155,42 @@ bool UTCPCommunicationSubsystem::Connect(const FString& InIPAddress, int32 InPor
         UE_LOG(LogTemp, Log, TEXT("Connected to server: %s:%d"), *InIPAddress, InPort);
 
         // 启动接收和发送线程
-        ReceiveTask = new FAsyncTask<FReceiveWorker>(this, Socket);
-        ReceiveTask->StartBackgroundTask();
-
-        SendTask = new FAsyncTask<FSendWorker>(this, Socket, SendQueue);
-        SendTask->StartBackgroundTask();
+        ReceiveProcessLatency.Reset();
+        ReceiveWakeLatency.Reset();
+        SendLatency.Reset();
+        SendThroughput.Reset();
+        EncodeStats.Reset();
+        DecodeStats.Reset();
+        ActiveCodec = Settings.MessageCodec;
+        bActiveParallelDecode = Settings.bParallelDecode && !(ActiveCodec == ENetworkMessageCodec::Protobuf && Settings.bUpbArenaDecode);
+
+        // 按当前参数限制发送队列
+        FSendQueue::FLimits QueueLimits;
+        QueueLimits.MaxMessages = FMath::Max(0, Settings.SendQueueMaxMessages);
+        QueueLimits.MaxBytes = FMath::Max<int64>(0, Settings.SendQueueMaxBytes);
+        QueueLimits.HighWatermark = Settings.SendQueueHighWatermark;
+        QueueLimits.LowWatermark = FMath::Min(Settings.SendQueueLowWatermark, Settings.SendQueueHighWatermark);
+        QueueLimits.OverflowPolicy = Settings.SendQueueOverflowPolicy;
+        QueueLimits.BlockTimeoutMs = (uint32)FMath::Max(0, Settings.SendQueueBlockTimeoutMs);
+        SendQueue.SetLimits(QueueLimits);
+        RpcCalls.SetCapacity(Settings.RpcMaxInFlight);
+        SendQueue.Open();
+
+        // 使用专用线程，不占用全局线程池
+        ReceiveWorker = new FReceiveWorker(this, Socket);
+        ReceiveThread = FRunnableThread::Create(ReceiveWorker, TEXT("TCPReceiveThread"), Settings.IoThreadStackSize, Settings.IoThreadPriority);
+
+        SendWorker = new FSendWorker(this, Socket, SendQueue, SendEvent);
+        SendThread = FRunnableThread::Create(SendWorker, TEXT("TCPSendThread"), Settings.IoThreadStackSize, Settings.IoThreadPriority);
+
+        // 收到的消息在游戏线程的Tick中分发，按当前TickGroup重新注册
+        RegisterInboxTick(GetWorld());
+
+        // 合并发送时每帧结束自动写出
+        if (Settings.bCoalesceSends && Settings.bFlushSendsAtEndOfFrame)
+        {
+            EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UTCPCommunicationSubsystem::FlushSends);
+        }
 
         // 启动心跳机制
         LastHeartbeatTime = FDateTime::UtcNow();
@@ -97,35 +220,64 @@ void UTCPCommunicationSubsystem::Disconnect()
             World->GetTimerManager().ClearTimer(HeartbeatTimer);
         }
         
-        // 关闭Socket
-        Socket->Close();
-        Socket.Reset();
-        // 清空队列
-        FNetworkMessage Dummy;
-        while (SendQueue.Dequeue(Dummy)) {}
+        FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+        EndFrameHandle.Reset();
 
+        // 先标记断开，工作线程被唤醒后据此退出
         bIsConnected = false;
+
+        // 关闭发送队列，唤醒阻塞在入队上的生产者
+        SendQueue.Close();
+
+        // 先Shutdown以唤醒阻塞在Wait上的接收线程，Socket要等线程结束后才能关闭
+        Socket->Shutdown(ESocketShutdownMode::ReadWrite);
+
+        // 唤醒挂起的发送线程
+        SendEvent->Trigger();
+
         UE_LOG(LogTemp, Log, TEXT("Disconnected from server"));
 
         // 通知连接状态变化
         NotifyConnectionStatusChanged(false);
 
         // 等待线程结束
-        if (ReceiveTask)
+        if (ReceiveThread)
+        {
+            ReceiveThread->Kill(true);
+            delete ReceiveThread;
+            ReceiveThread = nullptr;
+        }
+        delete ReceiveWorker;
+        ReceiveWorker = nullptr;
+
+        if (SendThread)
         {
-            ReceiveTask->EnsureCompletion();
-            delete ReceiveTask;
-            ReceiveTask = nullptr;
+            SendThread->Kill(true);
+            delete SendThread;
+            SendThread = nullptr;
         }
+        delete SendWorker;
+        SendWorker = nullptr;
+
+        // 收发线程都已退出，不会再访问Socket
+        Socket->Close();
+        Socket.Reset();
 
-        if (SendTask)
+        // 线程结束后再清空队列
+        SendQueue.Reset();
+
+        // 等待任务线程订阅者处理完已收到的消息，管道销毁前必须为空
+        for (TPair<uint16, TUniquePtr<UE::Tasks::FPipe>>& Pair : WorkerTaskPipes)
         {
-            SendTask->EnsureCompletion();
-            delete SendTask;
-            SendTask = nullptr;
+            Pair.Value->WaitUntilEmpty();
         }
+        WorkerTaskPipes.Empty();
 
+        // 等待已提交的解码任务把结果交给收件箱
+        DecodePipeline.Flush();
 
+        // 未完成的RPC调用不会再收到响应
+        RpcCalls.FailAll(ERpcStatus::Disconnected);
     }
 }
 
@@ -137,393 +289,1661 @@ bool UTCPCommunicationSubsystem::SendMessage(const FNetworkMessage& Message)
         return false;
     }
 
-    // 将消息加入发送队列
-    SendQueue.Enqueue(Message);
-    return true;
+    // 将消息加入发送队列，按字符串长度估算占用的字节数
+    const int64 SizeBytes = (int64)(Message.MessageType.Len() + Message.JsonData.Len()) * sizeof(TCHAR) + sizeof(FQueuedMessage);
+    FQueuedMessage Queued{ Message, FPlatformTime::Cycles64(), SizeBytes };
+    if (Queued.Message.CreatedUnixMicros == 0)
+    {
+        Queued.Message.CreatedUnixMicros = FNetworkMessage::GetUtcNowUnixMicros();
+    }
+    bool bWasEmpty = false;
+    const FSendQueue::EEnqueueResult Result = SendQueue.Enqueue(MoveTemp(Queued), bWasEmpty);
+
+    // 队列由空变为非空时唤醒发送线程
+    if (bWasEmpty)
+    {
+        SendEvent->Trigger();
+    }
+
+    switch (Result)
+    {
+    case FSendQueue::EEnqueueResult::Queued:
+        return true;
+    case FSendQueue::EEnqueueResult::QueuedDroppedOldest:
+        UE_LOG(LogTemp, Verbose, TEXT("Send queue full, dropped oldest message to queue %s"), *Message.MessageType);
+        return true;
+    case FSendQueue::EEnqueueResult::DroppedNewest:
+        // 消息没有入队，调用者（包括RPC）需要知道它不会被发送
+        UE_LOG(LogTemp, Verbose, TEXT("Send queue full, dropped message %s"), *Message.MessageType);
+        return false;
+    case FSendQueue::EEnqueueResult::Rejected:
+        UE_LOG(LogTemp, Warning, TEXT("Send queue full, message %s rejected"), *Message.MessageType);
+        return false;
+    default:
+        return false;
+    }
+}
+
+void UTCPCommunicationSubsystem::FlushSends()
+{
+    if (!bIsConnected || !Settings.bCoalesceSends)
+    {
+        return;
+    }
+
+    // 通知发送线程立即写出合并窗口中的消息
+    bFlushRequested = true;
+    SendEvent->Trigger();
 }
 
 void UTCPCommunicationSubsystem::RegisterMessageHandler(FOnMessageReceived InHandler)
 {
     MessageReceivedDelegate = InHandler;
+    UpdateCatchAllHandlers();
 }
 
-void UTCPCommunicationSubsystem::RegisterConnectionStatusHandler(FOnConnectionStatusChanged InHandler)
+void UTCPCommunicationSubsystem::RegisterMessagePayloadHandler(FOnMessagePayloadReceived InHandler)
 {
-    ConnectionStatusDelegate = InHandler;
+    MessagePayloadDelegate = InHandler;
+    UpdateCatchAllHandlers();
 }
 
-void UTCPCommunicationSubsystem::SendHeartbeat()
+void UTCPCommunicationSubsystem::RegisterEnvelopeHandler(FOnEnvelopeReceived InHandler)
 {
-    if (!bIsConnected) return;
-    
-    // 发送心跳消息
-    FNetworkMessage HeartbeatMsg(TEXT("Heartbeat"), TEXT("{}"));
-    SendMessage(HeartbeatMsg);
-    
-    // 检查是否超时
-    CheckHeartbeatTimeout();
+    EnvelopeReceivedDelegate = InHandler;
+    UpdateCatchAllHandlers();
 }
 
-void UTCPCommunicationSubsystem::CheckHeartbeatTimeout()
+int32 UTCPCommunicationSubsystem::RegisterMessageType(const FString& Type)
 {
-    if (!bIsConnected) return;
+    return MessageTypes.Register(Type);
+}
 
-    FTimespan TimeSinceLastHeartbeat = FDateTime::UtcNow() - LastHeartbeatTime;
-    if (TimeSinceLastHeartbeat.GetTotalSeconds() > HeartbeatTimeout)
+void UTCPCommunicationSubsystem::SetMessageTypeDropped(const FString& Type, bool bDropped)
+{
+    // 丢弃按ID进行，与已注册类型冲突时会把那个类型也丢掉
+    if (bDropped && MessageTypes.Register(Type) == INDEX_NONE)
     {
-        UE_LOG(LogTemp, Error, TEXT("Heartbeat timeout, disconnecting..."));
-        Disconnect();
+        UE_LOG(LogTemp, Error, TEXT("Not dropping message type '%s': its type id is shared with another registered type"), *Type);
+        return;
     }
-    
+    DroppedMessageTypes.Set(FMessageTypeRegistry::MakeId(Type), bDropped);
 }
 
-void UTCPCommunicationSubsystem::HandleHeartbeat()
+void UTCPCommunicationSubsystem::SetMessageTypeCoalesced(const FString& Type, bool bCoalesced, const FString& KeyField)
 {
-    LastHeartbeatTime = FDateTime::UtcNow();
-    UE_LOG(LogTemp, Log, TEXT("Received heartbeat from server"));
+    const uint16 TypeId = FMessageTypeRegistry::MakeId(Type);
+
+    // 写时复制：接收线程持有的旧快照不受影响
+    TSharedRef<FCoalesceKeyFieldTable, ESPMode::ThreadSafe> NewTable = CoalesceKeyFields.IsValid()
+        ? MakeShared<FCoalesceKeyFieldTable, ESPMode::ThreadSafe>(*CoalesceKeyFields)
+        : MakeShared<FCoalesceKeyFieldTable, ESPMode::ThreadSafe>();
+    if (bCoalesced)
+    {
+        const FTCHARToUTF8 KeyFieldUtf8(*KeyField, KeyField.Len());
+        NewTable->Add(TypeId, TArray<UTF8CHAR>(reinterpret_cast<const UTF8CHAR*>(KeyFieldUtf8.Get()), KeyFieldUtf8.Length()));
+    }
+    else
+    {
+        NewTable->Remove(TypeId);
+    }
+    {
+        FWriteScopeLock WriteLock(CoalesceKeyFieldsLock);
+        CoalesceKeyFields = NewTable;
+    }
+    CoalescedMessageTypes.Set(TypeId, bCoalesced);
 }
 
-FString UTCPCommunicationSubsystem::SerializeMessage(const FNetworkMessage& Message)
+FDelegateHandle UTCPCommunicationSubsystem::SubscribeToMessageType(const FString& Type, FOnMessageReceived Handler, EMessageHandlerThread Thread)
 {
-    TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject());
-    JsonObject->SetStringField(TEXT("Type"), Message.MessageType);
-    JsonObject->SetStringField(TEXT("Data"), Message.JsonData);
+    const int32 TypeIndex = MessageTypes.Register(Type);
+    if (TypeIndex == INDEX_NONE || !Handler.IsBound())
+    {
+        return FDelegateHandle();
+    }
+
+    // 非游戏线程订阅者放入接收线程读取的快照，这些消息不进入游戏线程收件箱
+    if (Thread != EMessageHandlerThread::GameThread)
+    {
+        const uint16 TypeId = FMessageTypeRegistry::MakeId(Type);
+        const FDelegateHandle Handle(FDelegateHandle::GenerateNewHandle);
+        UpdateWorkerSubscribers([&](FWorkerSubscriberTable& Table)
+        {
+            Table.FindOrAdd(TypeId).Add(FWorkerMessageSubscriber{ Handle, MoveTemp(Handler), Thread, Type });
+        });
+        WorkerSubscriptionTypeIds.Add(Handle, TypeId);
+        WorkerMessageTypes.Set(TypeId, true);
+        return Handle;
+    }
 
-    FString JsonString;
-    TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&JsonString);
-    FJsonSerializer::Serialize(JsonObject.ToSharedRef(), Writer);
+    // 订阅表按稠密索引存放，元素地址稳定，广播期间订阅新类型不会移动正在广播的委托
+    while (TypeSubscribers.Num() <= TypeIndex)
+    {
+        TypeSubscribers.Add(new FOnTypedMessageReceived());
+    }
 
-    return JsonString;
+    const FDelegateHandle Handle = TypeSubscribers[TypeIndex].Add(MoveTemp(Handler));
+    SubscriptionTypeIndices.Add(Handle, TypeIndex);
+    SubscribedMessageTypes.Set(FMessageTypeRegistry::MakeId(Type), true);
+    return Handle;
 }
 
-bool UTCPCommunicationSubsystem::DeserializeMessage(const FString& JsonString, FNetworkMessage& OutMessage)
+bool UTCPCommunicationSubsystem::UnsubscribeFromMessageType(FDelegateHandle Handle)
 {
-    TSharedPtr<FJsonObject> JsonObject;
-    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
-
-    if (FJsonSerializer::Deserialize(Reader, JsonObject) && JsonObject.IsValid())
+    uint16 TypeId = FMessageTypeRegistry::InvalidId;
+    if (WorkerSubscriptionTypeIds.RemoveAndCopyValue(Handle, TypeId))
     {
-        OutMessage.MessageType = JsonObject->GetStringField(TEXT("Type"));
-        OutMessage.JsonData = JsonObject->GetStringField(TEXT("Data"));
+        bool bTypeEmpty = false;
+        UpdateWorkerSubscribers([&](FWorkerSubscriberTable& Table)
+        {
+            TArray<FWorkerMessageSubscriber>& Subscribers = Table.FindChecked(TypeId);
+            Subscribers.RemoveAll([&Handle](const FWorkerMessageSubscriber& Subscriber) { return Subscriber.Handle == Handle; });
+            if (Subscribers.Num() == 0)
+            {
+                Table.Remove(TypeId);
+                bTypeEmpty = true;
+            }
+        });
+        if (bTypeEmpty)
+        {
+            WorkerMessageTypes.Set(TypeId, false);
+        }
         return true;
     }
 
-    UE_LOG(LogTemp, Error, TEXT("Failed to deserialize message: %s"), *JsonString);
-    return false;
+    int32 TypeIndex = INDEX_NONE;
+    if (!SubscriptionTypeIndices.RemoveAndCopyValue(Handle, TypeIndex))
+    {
+        return false;
+    }
+
+    FOnTypedMessageReceived& Subscribers = TypeSubscribers[TypeIndex];
+    Subscribers.Remove(Handle);
+    if (!Subscribers.IsBound())
+    {
+        // 最后一个订阅者退订后，接收线程不再把该类型的消息交给游戏线程
+        SubscribedMessageTypes.Set(FMessageTypeRegistry::MakeId(MessageTypes.GetName(TypeIndex)), false);
+    }
+    return true;
 }
 
+int32 UTCPCommunicationSubsystem::FindSubscribedTypeIndex(uint16 TypeId) const
+{
+    const int32 TypeIndex = MessageTypes.FindIndex(TypeId);
+    if (TypeIndex == INDEX_NONE || TypeIndex >= TypeSubscribers.Num() || !TypeSubscribers[TypeIndex].IsBound())
+    {
+        return INDEX_NONE;
+    }
+    return TypeIndex;
+}
 
-void UTCPCommunicationSubsystem::ProcessReceivedData(const TArray<uint8>& Data)
+FOnTypedMessageReceived* UTCPCommunicationSubsystem::FindTypeSubscribers(uint16 TypeId, FUtf8StringView Type)
 {
-    // 将新数据添加到缓冲区
-    ReceiveBuffer.Append(Data);
-    // 消息格式：4字节长度前缀（大端序） + 消息内容
-    if (ReceiveBuffer.Num() < 4)
+    const int32 TypeIndex = FindSubscribedTypeIndex(TypeId);
+    if (TypeIndex == INDEX_NONE)
     {
-        // 数据不足，等待更多数据
-        return;
+        return nullptr;
     }
-    // 将字节转换为字符串
-    FString MessageString = UMessageMangerBPLibrary::ConvertUtf8BinaryToString(ReceiveBuffer);
-    ReceiveBuffer.Empty();
-    // 触发消息接收回调（在游戏线程中执行）
-    AsyncTask(ENamedThreads::GameThread, [this, MessageString]()
+    if (!MessageTypes.IsName(TypeIndex, Type))
     {
-        // 反序列化消息
-        FNetworkMessage NetworkMessage;
-        if (DeserializeMessage(MessageString, NetworkMessage))
-        {
-            BroadcastMessage(NetworkMessage);
-        }
-    });
+        ReportTypeCollision(TypeId, TypeIndex, UMessageMangerBPLibrary::ConvertUtf8BinaryToString(reinterpret_cast<const uint8*>(Type.GetData()), Type.Len()));
+        return nullptr;
+    }
+    return &TypeSubscribers[TypeIndex];
 }
 
-void UTCPCommunicationSubsystem::BroadcastMessage(const FNetworkMessage& NetworkMessage)
+FOnTypedMessageReceived* UTCPCommunicationSubsystem::FindTypeSubscribers(uint16 TypeId, FStringView Type)
 {
-    // 处理心跳消息
-    if (NetworkMessage.MessageType == TEXT("Heartbeat"))
+    const int32 TypeIndex = FindSubscribedTypeIndex(TypeId);
+    if (TypeIndex == INDEX_NONE)
     {
-        HandleHeartbeat();
-        return;
+        return nullptr;
     }
-    if (MessageReceivedDelegate.IsBound())
+    if (!MessageTypes.IsName(TypeIndex, Type))
     {
-        MessageReceivedDelegate.Execute(NetworkMessage);
+        ReportTypeCollision(TypeId, TypeIndex, FString(Type));
+        return nullptr;
     }
+    return &TypeSubscribers[TypeIndex];
 }
 
-void UTCPCommunicationSubsystem::NotifyConnectionStatusChanged(bool bNewConnected)
+void UTCPCommunicationSubsystem::ReportTypeCollision(uint16 TypeId, int32 TypeIndex, const FString& Type)
 {
-    AsyncTask(ENamedThreads::GameThread, [this, bNewConnected]()
+    bool bAlreadyReported = false;
+    ReportedTypeCollisions.Add(TypeId, &bAlreadyReported);
+    if (!bAlreadyReported)
     {
-        if (ConnectionStatusDelegate.IsBound())
-        {
-            ConnectionStatusDelegate.Execute(bNewConnected);
-        }
-    });
+        UE_LOG(LogTemp, Warning, TEXT("Received message type '%s' shares type id %u with subscribed type '%s', not delivering it to those subscribers; rename one of them"),
+            *Type, TypeId, *MessageTypes.GetName(TypeIndex));
+    }
 }
 
-// 接收线程实现
-void FReceiveWorker::DoWork()
+void UTCPCommunicationSubsystem::UpdateWorkerSubscribers(TFunctionRef<void(FWorkerSubscriberTable&)> Update)
 {
-    if (!Socket.IsValid() || !Subsystem)
+    // 写时复制：接收线程和任务线程持有的旧快照不受影响
+    TSharedRef<FWorkerSubscriberTable, ESPMode::ThreadSafe> NewTable = WorkerSubscribers.IsValid()
+        ? MakeShared<FWorkerSubscriberTable, ESPMode::ThreadSafe>(*WorkerSubscribers)
+        : MakeShared<FWorkerSubscriberTable, ESPMode::ThreadSafe>();
+    Update(*NewTable);
+
+    FWriteScopeLock Lock(WorkerSubscribersLock);
+    WorkerSubscribers = NewTable;
+}
+
+void UTCPCommunicationSubsystem::DispatchToWorkerSubscribers(uint16 TypeId, TFunctionRef<bool(FNetworkMessage&)> Decode)
+{
+    // 先查无锁的位集，没有非游戏线程订阅者的类型不加锁
+    if (!WorkerMessageTypes.Contains(TypeId) || DroppedMessageTypes.Contains(TypeId))
     {
         return;
     }
 
-    // 定义最大接收分片大小为64KB (65536字节)
-    const int32 MAX_CHUNK_SIZE = 65536;
-    // 分片头部结构 (与发送端对应)
-    struct FChunkHeader
+    TSharedPtr<const FWorkerSubscriberTable, ESPMode::ThreadSafe> Table;
     {
-        uint32 MessageId = 0;
-        uint32 TotalLength = 0;
-        uint32 ChunkIndex = 0;
-        uint8 IsLastChunk = 0;
-    };
-    const int32 HEADER_SIZE = sizeof(FChunkHeader);
+        FReadScopeLock Lock(WorkerSubscribersLock);
+        Table = WorkerSubscribers;
+    }
+    const TArray<FWorkerMessageSubscriber>* Subscribers = Table.IsValid() ? Table->Find(TypeId) : nullptr;
+    if (!Subscribers)
+    {
+        return;
+    }
 
-    // 用于缓存分片数据的结构
-    struct FPartialMessage
+    TSharedRef<FNetworkMessage, ESPMode::ThreadSafe> Message = MakeShared<FNetworkMessage, ESPMode::ThreadSafe>();
+    if (!Decode(*Message))
     {
-        TArray<uint8> Data;          // 完整数据缓冲区
-        int32 ReceivedChunks;       // 已接收的分片数
-        int32 TotalChunks;          // 总分片数
-        FDateTime LastActivityTime; // 最后活动时间，用于超时处理
-    };
+        return;
+    }
 
-    // 存储所有部分接收的消息 (MessageId -> 部分消息)
-    TMap<uint32, FPartialMessage> PartialMessages;
+    // RPC响应只在游戏线程交给等待的调用
+    if (Message->bIsResponse)
+    {
+        return;
+    }
 
-    UE_LOG(LogTemp, Log, TEXT("Receive worker started with chunking (max %d bytes per chunk)"), MAX_CHUNK_SIZE);
+    // 同一个ID下的订阅者订阅的是同一个类型名（注册表拒绝冲突的名字），与ID冲突的其他类型不交给它们
+    if (!Message->MessageType.Equals((*Subscribers)[0].Type, ESearchCase::CaseSensitive))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("Message type '%s' shares type id %u with '%s', skipping worker subscribers"),
+            *Message->MessageType, TypeId, *(*Subscribers)[0].Type);
+        return;
+    }
 
-    while (Subsystem->IsConnected() && Socket.IsValid())
+    bool bHasTaskSubscribers = false;
+    for (const FWorkerMessageSubscriber& Subscriber : *Subscribers)
     {
-        uint32 PendingDataSize;
-        if (Socket->HasPendingData(PendingDataSize))
+        if (Subscriber.Thread == EMessageHandlerThread::ReceiveThread)
         {
-            // 一次最多读取64KB数据
-            int32 ReadSize = FMath::Min(PendingDataSize, (uint32)MAX_CHUNK_SIZE);
-            FArrayReader ReceiveData = FArrayReader(true);
-            ReceiveData.SetNumUninitialized(ReadSize);
-
-            int32 BytesRead = 0;
-            if (Socket->Recv(ReceiveData.GetData(), ReadSize, BytesRead) && BytesRead > 0)
-            {
-                ReceiveData.SetNum(BytesRead);
-
-                // 检查是否有足够的数据容纳头部
-                if (BytesRead < HEADER_SIZE)
-                {
-                    UE_LOG(LogTemp, Error, TEXT("Received data too small for header (size: %d)"), BytesRead);
-                    break;
-                }
-
-                // 解析头部信息
-                FChunkHeader Header;
-                FMemory::Memcpy(&Header, ReceiveData.GetData(), HEADER_SIZE);
-
-                // 提取实际数据部分
-                TArray<uint8> ChunkData;
-                ChunkData.Append(ReceiveData.GetData() + HEADER_SIZE, BytesRead - HEADER_SIZE);
-
-                UE_LOG(LogTemp, Log, TEXT("Received chunk %d (MessageId: %u, size: %d bytes)"),
-                    Header.ChunkIndex, Header.MessageId, ChunkData.Num());
-
-                // 检查是否是新消息
-                if (!PartialMessages.Contains(Header.MessageId))
-                {
-                    // 计算总分片数
-                    int32 TotalChunks = FMath::CeilToInt((float)Header.TotalLength / MAX_CHUNK_SIZE);
-
-                    // 初始化新的部分消息
-                    FPartialMessage NewMessage;
-                    NewMessage.Data.SetNumUninitialized(Header.TotalLength);
-                    NewMessage.ReceivedChunks = 0;
-                    NewMessage.TotalChunks = TotalChunks;
-                    NewMessage.LastActivityTime = FDateTime::UtcNow();
-
-                    PartialMessages.Add(Header.MessageId, NewMessage);
-                }
-
-                // 获取当前消息的缓存
-                FPartialMessage& CurrentMessage = PartialMessages[Header.MessageId];
-
-                // 验证分片有效性
-                if (Header.ChunkIndex >= (uint32)CurrentMessage.TotalChunks)
-                {
-                    UE_LOG(LogTemp, Error, TEXT("Invalid chunk index %d for message %u (total chunks: %d)"),
-                        Header.ChunkIndex, Header.MessageId, CurrentMessage.TotalChunks);
-                    PartialMessages.Remove(Header.MessageId);
-                    continue;
-                }
-
-                // 计算当前分片在完整数据中的偏移量
-                int32 ChunkOffset = Header.ChunkIndex * MAX_CHUNK_SIZE;
-
-                // 确保偏移量不超过总长度
-                if (ChunkOffset + ChunkData.Num() > CurrentMessage.Data.Num())
-                {
-                    UE_LOG(LogTemp, Error, TEXT("Chunk data exceeds message size for message %u"), Header.MessageId);
-                    PartialMessages.Remove(Header.MessageId);
-                    continue;
-                }
-
-                // 将分片数据复制到完整缓冲区
-                FMemory::Memcpy(CurrentMessage.Data.GetData() + ChunkOffset, ChunkData.GetData(), ChunkData.Num());
-                CurrentMessage.ReceivedChunks++;
-                CurrentMessage.LastActivityTime = FDateTime::UtcNow();
-
-                // 检查是否接收完所有分片
-                if (Header.IsLastChunk && CurrentMessage.ReceivedChunks == CurrentMessage.TotalChunks)
-                {
-                    UE_LOG(LogTemp, Log, TEXT("Message %u fully received (%d bytes)"),
-                        Header.MessageId, CurrentMessage.Data.Num());
-
-                    // 将完整数据传递给处理函数
-                    FArrayReader CompleteData = FArrayReader(true);
-                    CompleteData.Append(CurrentMessage.Data);
-                    Subsystem->ProcessReceivedData(CompleteData);
-
-                    // 从缓存中移除
-                    PartialMessages.Remove(Header.MessageId);
-                }
-            }
-            else
-            {
-                // 接收失败，断开连接
-                UE_LOG(LogTemp, Error, TEXT("Failed to receive data"));
-                
-                AsyncTask(ENamedThreads::GameThread, [this]()
-                {
-                        Subsystem->Disconnect();
-                });
-                break;
-            }
+            Subscriber.Handler.ExecuteIfBound(*Message);
         }
-        
-
-        // 清理超时的部分消息（5秒超时）
-        TArray<uint32> ExpiredMessages;
-        for (const auto& Pair : PartialMessages)
+        else
         {
-            if (FDateTime::UtcNow() - Pair.Value.LastActivityTime > FTimespan::FromSeconds(5))
-            {
-                ExpiredMessages.Add(Pair.Key);
-            }
+            bHasTaskSubscribers = true;
         }
-        for (uint32 MsgId : ExpiredMessages)
+    }
+
+    // 一条消息的所有任务线程订阅者在同一个任务中执行，任务持有快照，退订不会释放正在使用的委托
+    // 同一类型的任务进入同一个管道，订阅者看到的消息顺序与到达顺序一致，也不会与自己并发
+    if (bHasTaskSubscribers)
+    {
+        TUniquePtr<UE::Tasks::FPipe>& Pipe = WorkerTaskPipes.FindOrAdd(TypeId);
+        if (!Pipe.IsValid())
         {
-            UE_LOG(LogTemp, Warning, TEXT("Message %u expired (incomplete chunks)"), MsgId);
-            PartialMessages.Remove(MsgId);
+            Pipe = MakeUnique<UE::Tasks::FPipe>(TEXT("TCPWorkerSubscribers"));
         }
-
-        // 短暂休眠，减少CPU占用
-        FPlatformProcess::Sleep(0.001f);
+        Pipe->Launch(UE_SOURCE_LOCATION, [Table, Subscribers, Message]()
+        {
+            for (const FWorkerMessageSubscriber& Subscriber : *Subscribers)
+            {
+                if (Subscriber.Thread == EMessageHandlerThread::TaskWorker)
+                {
+                    Subscriber.Handler.ExecuteIfBound(*Message);
+                }
+            }
+        });
     }
+}
 
-    UE_LOG(LogTemp, Log, TEXT("Receive worker stopped"));
+bool UTCPCommunicationSubsystem::IsMessageTypeWanted(uint16 TypeId) const
+{
+    return IsMessageTypeWantedOnGameThread(TypeId)
+        || (WorkerMessageTypes.Contains(TypeId) && !DroppedMessageTypes.Contains(TypeId));
 }
 
-// 发送线程实现
-void FSendWorker::DoWork()
+bool UTCPCommunicationSubsystem::IsMessageTypeWantedOnGameThread(uint16 TypeId) const
 {
-    if (!Socket.IsValid() || !Subsystem)
+    if (DroppedMessageTypes.Contains(TypeId))
     {
-        return;
+        return false;
     }
-
-    // 定义最大分片大小为64KB (65536字节)
-    const int32 MAX_CHUNK_SIZE = 65536;
-
-    UE_LOG(LogTemp, Log, TEXT("Send worker started with chunking (max %d bytes per chunk)"), MAX_CHUNK_SIZE);
-
-    while (Subsystem->IsConnected() && Socket.IsValid())
+    if (TypeId == FMessageTypeRegistry::InvalidId || TypeId == MessageTypeIds::Heartbeat)
     {
-        // 从队列中获取消息
-        FNetworkMessage Message;
-        while (SendQueue.Dequeue(Message))
-        {
-            // 序列化消息
-            FString JsonString = Subsystem->SerializeMessage(Message);
+        return true;
+    }
+    return bHasCatchAllHandlers.load(std::memory_order_relaxed) || SubscribedMessageTypes.Contains(TypeId)
+        || RpcResponseTypes.Contains(TypeId);
+}
 
-            // 转换为UTF-8字节流
-            TArray<uint8> OutMsgData;
-            UMessageMangerBPLibrary::ConvertFStringToBinary(JsonString, OutMsgData);
-            int32 TotalDataLength = OutMsgData.Num();
-            // 如果数据为空则跳过
-            if (TotalDataLength <= 0)
-            {
-                UE_LOG(LogTemp, Warning, TEXT("Skipping empty message"));
-                continue;
-            }
+void UTCPCommunicationSubsystem::UpdateCatchAllHandlers()
+{
+    bHasCatchAllHandlers = MessageReceivedDelegate.IsBound() || MessagePayloadDelegate.IsBound()
+        || JsonMessageDelegate.IsBound() || EnvelopeReceivedDelegate.IsBound();
+}
 
-            // 计算总分片数
-            int32 TotalChunks = FMath::CeilToInt((float)TotalDataLength / MAX_CHUNK_SIZE);
-            UE_LOG(LogTemp, Log, TEXT("Sending message as %d chunks (total %d bytes)"), TotalChunks, TotalDataLength);
+void UTCPCommunicationSubsystem::RegisterJsonMessageHandler(FOnJsonMessageReceived InHandler)
+{
+    JsonMessageDelegate = InHandler;
+    UpdateCatchAllHandlers();
+}
 
-            // 生成消息唯一ID，用于接收端重组
-            uint32 MessageId = FMath::Rand(); // 实际项目中应使用更可靠的ID生成方式
+void UTCPCommunicationSubsystem::RegisterConnectionStatusHandler(FOnConnectionStatusChanged InHandler)
+{
+    ConnectionStatusDelegate = InHandler;
+}
 
-            // 分片发送
-            for (int32 ChunkIndex = 0; ChunkIndex < TotalChunks; ChunkIndex++)
-            {
-                // 计算当前分片的偏移量和大小
-                int32 ChunkOffset = ChunkIndex * MAX_CHUNK_SIZE;
-                int32 ChunkSize = FMath::Min(MAX_CHUNK_SIZE, TotalDataLength - ChunkOffset);
+void UTCPCommunicationSubsystem::RegisterSendQueueWatermarkHandler(FOnSendQueueWatermark InHandler)
+{
+    SendQueueWatermarkDelegate = InHandler;
+}
 
-                // 构建分片头部 (共13字节: 4字节消息ID + 4字节总长度 + 4字节分片索引 + 1字节是否最后分片)
-                struct FChunkHeader
+void UTCPCommunicationSubsystem::SendHeartbeat()
+{
+    if (!bIsConnected) return;
+    
+    // 发送心跳消息，走控制通道，不会排在大消息后面
+    FNetworkMessage HeartbeatMsg(TEXT("Heartbeat"), TEXT("{}"), ENetworkMessagePriority::Control);
+    SendMessage(HeartbeatMsg);
+    
+    // 检查是否超时
+    CheckHeartbeatTimeout();
+}
+
+void UTCPCommunicationSubsystem::CheckHeartbeatTimeout()
+{
+    if (!bIsConnected) return;
+
+    FTimespan TimeSinceLastHeartbeat = FDateTime::UtcNow() - LastHeartbeatTime;
+    if (TimeSinceLastHeartbeat.GetTotalSeconds() > HeartbeatTimeout)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Heartbeat timeout, disconnecting..."));
+        Disconnect();
+    }
+    
+}
+
+void UTCPCommunicationSubsystem::HandleHeartbeat()
+{
+    LastHeartbeatTime = FDateTime::UtcNow();
+    UE_LOG(LogTemp, Log, TEXT("Received heartbeat from server"));
+}
+
+FString UTCPCommunicationSubsystem::SerializeMessage(const FNetworkMessage& Message)
+{
+    TArray<uint8> JsonBytes;
+    EncodeMessage(Message, ENetworkMessageCodec::Json, JsonBytes);
+    return UMessageMangerBPLibrary::ConvertUtf8BinaryToString(JsonBytes);
+}
+
+bool UTCPCommunicationSubsystem::DeserializeMessage(const FString& JsonString, FNetworkMessage& OutMessage)
+{
+    TArray<uint8> JsonBytes;
+    UMessageMangerBPLibrary::ConvertFStringToBinary(JsonString, JsonBytes);
+    return DecodeMessage(JsonBytes.GetData(), JsonBytes.Num(), ENetworkMessageCodec::Json, OutMessage);
+}
+
+bool UTCPCommunicationSubsystem::ReadJsonMessage(const FJsonOnDemandValue& Root, FNetworkMessage& OutMessage)
+{
+    if (Root.GetType() != EJsonOnDemandType::Object)
+    {
+        return false;
+    }
+
+    // 缺少的字段按空字符串处理
+    OutMessage.MessageType.Reset();
+    OutMessage.JsonData.Reset();
+    OutMessage.CorrelationId = 0;
+    OutMessage.bIsResponse = false;
+    Root.FindField(UTF8TEXTVIEW("CorrelationId")).GetInt64(OutMessage.CorrelationId);
+    Root.FindField(UTF8TEXTVIEW("Response")).GetBool(OutMessage.bIsResponse);
+    const FJsonOnDemandValue Type = Root.FindField(UTF8TEXTVIEW("Type"));
+    if (Type.IsValid() && !Type.GetString(OutMessage.MessageType))
+    {
+        return false;
+    }
+
+    // Data可以是转义后的字符串，也可以是直接嵌入的JSON值（JsonRawData），后者原样取出原始文本
+    const FJsonOnDemandValue Data = Root.FindField(UTF8TEXTVIEW("Data"));
+    if (Data.GetType() == EJsonOnDemandType::String)
+    {
+        return Data.GetString(OutMessage.JsonData);
+    }
+    if (Data.IsValid())
+    {
+        const FUtf8StringView RawData = Data.GetRawJson();
+        OutMessage.JsonData = UMessageMangerBPLibrary::ConvertUtf8BinaryToString(reinterpret_cast<const uint8*>(RawData.GetData()), RawData.Len());
+    }
+    return true;
+}
+
+void UTCPCommunicationSubsystem::EncodeMessage(const FNetworkMessage& Message, ENetworkMessageCodec Codec, TArray<uint8>& OutBytes)
+{
+    if (Codec == ENetworkMessageCodec::Protobuf)
+    {
+        OutBytes.Reset();
+        FProtobufEnvelopeCodec::Encode(Message, OutBytes);
+        return;
+    }
+
+    // 直接写出UTF-8，不构造FJsonObject和中间字符串
+    OutBytes.Reset();
+    FJsonStreamWriter Writer(OutBytes);
+    Writer.BeginObject();
+    Writer.WriteStringField(ANSITEXTVIEW("Type"), Message.MessageType);
+
+    // 字符串值直接嵌入后接收端无法和转义的字符串区分，仍按字符串写入
+    bool bEmbedRaw = Codec == ENetworkMessageCodec::JsonRawData;
+    for (const TCHAR Char : Message.JsonData)
+    {
+        if (!FChar::IsWhitespace(Char))
+        {
+            bEmbedRaw &= Char != TEXT('"');
+            break;
+        }
+    }
+    if (!bEmbedRaw || !Writer.WriteRawField(ANSITEXTVIEW("Data"), Message.JsonData))
+    {
+        Writer.WriteStringField(ANSITEXTVIEW("Data"), Message.JsonData);
+    }
+    if (Message.CorrelationId != 0)
+    {
+        Writer.WriteUInt64Field(ANSITEXTVIEW("CorrelationId"), (uint64)Message.CorrelationId);
+    }
+    if (Message.bIsResponse)
+    {
+        Writer.WriteBoolField(ANSITEXTVIEW("Response"), true);
+    }
+    Writer.EndObject();
+}
+
+bool UTCPCommunicationSubsystem::DecodeMessage(const uint8* Data, int32 Length, ENetworkMessageCodec Codec, FNetworkMessage& OutMessage)
+{
+    if (Codec == ENetworkMessageCodec::Protobuf)
+    {
+        if (!FProtobufEnvelopeCodec::Decode(Data, Length, OutMessage))
+        {
+            UE_LOG(LogTemp, Error, TEXT("Failed to decode protobuf envelope (%d bytes)"), Length);
+            return false;
+        }
+        return true;
+    }
+
+    // 直接在UTF-8字节上建立结构索引，只转换Type和Data两个字段
+    static thread_local FJsonOnDemandDocument Document;
+    if (!Document.Parse(Data, Length) || !ReadJsonMessage(Document.GetRoot(), OutMessage))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to deserialize message: %s"), *UMessageMangerBPLibrary::ConvertUtf8BinaryToString(Data, Length));
+        return false;
+    }
+    return true;
+}
+
+FString UTCPCommunicationSubsystem::BenchmarkCodecs(const FNetworkMessage& Sample, int32 Iterations)
+{
+    Iterations = FMath::Max(1, Iterations);
+
+    // 按发送线程的方式填写序号和时间戳，使protobuf的字节数与线上一致
+    FNetworkMessage Message = Sample;
+    Message.Sequence = Iterations;
+    Message.CreatedUnixMicros = FNetworkMessage::GetUtcNowUnixMicros();
+    Message.SentUnixMicros = Message.CreatedUnixMicros;
+
+    FString Report;
+    for (ENetworkMessageCodec Codec : { ENetworkMessageCodec::Json, ENetworkMessageCodec::JsonRawData, ENetworkMessageCodec::Protobuf })
+    {
+        if (Codec == ENetworkMessageCodec::Protobuf && !FProtobufEnvelopeCodec::IsAvailable())
+        {
+            continue;
+        }
+
+        FCodecCounter EncodeCounter;
+        FCodecCounter DecodeCounter;
+        TArray<uint8> Bytes;
+        for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            uint64 StartCycles = FPlatformTime::Cycles64();
+            EncodeMessage(Message, Codec, Bytes);
+            EncodeCounter.AddMessage(Bytes.Num(), FPlatformTime::Cycles64() - StartCycles);
+
+            FNetworkMessage Decoded;
+            StartCycles = FPlatformTime::Cycles64();
+            const bool bDecoded = DecodeMessage(Bytes.GetData(), Bytes.Num(), Codec, Decoded);
+            DecodeCounter.AddMessage(Bytes.Num(), FPlatformTime::Cycles64() - StartCycles);
+            if (!bDecoded)
+            {
+                break;
+            }
+        }
+
+        Report += FString::Printf(TEXT("%s encode: %s, decode: %s\n"), *UEnum::GetValueAsString(Codec),
+            *EncodeCounter.Snapshot().ToString(), *DecodeCounter.Snapshot().ToString());
+    }
+
+    // upb解码（线格式与Protobuf相同），与接收线程一样每条信封使用栈上的临时arena
+    if (FProtobufEnvelopeCodec::IsAvailable())
+    {
+        TArray<uint8> Bytes;
+        EncodeMessage(Message, ENetworkMessageCodec::Protobuf, Bytes);
+        const FMessagePayloadView Source(MakeShared<TArray<uint8>, ESPMode::ThreadSafe>(MoveTemp(Bytes)));
+
+        FCodecCounter UpbCounter;
+        for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+        {
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            FNetworkEnvelopeView Envelope;
+            FUpbEnvelopeDecoder::Decode(Source, Envelope);
+            UpbCounter.AddMessage(Source.Num(), FPlatformTime::Cycles64() - StartCycles);
+        }
+
+        Report += FString::Printf(TEXT("Protobuf upb decode: %s\n"), *UpbCounter.Snapshot().ToString());
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("Codec benchmark (%d iterations):\n%s"), Iterations, *Report);
+    return Report;
+}
+
+
+void UTCPCommunicationSubsystem::ProcessReceivedData(FMessagePayloadView Payload, uint16 TypeId)
+{
+    if (Payload.Num() == 0)
+    {
+        return;
+    }
+
+    // 非游戏线程订阅者在这里解码并处理
+    DispatchToWorkerSubscribers(TypeId, [this, &Payload](FNetworkMessage& OutMessage)
+    {
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        const bool bDecoded = DecodeMessage(Payload.GetData(), Payload.Num(), ActiveCodec, OutMessage);
+        DecodeStats.AddMessage(Payload.Num(), FPlatformTime::Cycles64() - StartCycles);
+        return bDecoded;
+    });
+
+    // 游戏线程需要的消息放入收件箱，由游戏线程的Tick分发，只传递缓冲区引用，不复制数据
+    if (!IsMessageTypeWantedOnGameThread(TypeId))
+    {
+        return;
+    }
+    FInboxEntry Entry{ MoveTemp(Payload), TypeId };
+    const bool bCoalescedType = CoalescedMessageTypes.Contains(TypeId);
+    if (bCoalescedType)
+    {
+        // 合并的类型需要在接收线程解码才能取出键，游戏线程直接使用解码结果
+        DecodeInboxEntry(Entry);
+        Entry.bCoalesce = GetCoalesceKey(Entry, Entry.CoalesceKey);
+    }
+
+    if (!bActiveParallelDecode)
+    {
+        Inbox.Enqueue(MoveTemp(Entry));
+        return;
+    }
+
+    // 并行解码时所有消息都经过流水线分配序号，心跳和小消息不解码，只占位保持顺序
+    const bool bDecodeInParallel = !bCoalescedType && TypeId != MessageTypeIds::Heartbeat && Entry.Payload.Num() >= Settings.ParallelDecodeMinBytes;
+    DecodePipeline.Submit(MoveTemp(Entry), bDecodeInParallel);
+}
+
+bool UTCPCommunicationSubsystem::GetCoalesceKey(const FInboxEntry& Entry, uint64& OutKey) const
+{
+    // 只在读锁内复制快照指针，键字段本身不复制
+    TSharedPtr<const FCoalesceKeyFieldTable, ESPMode::ThreadSafe> Table;
+    {
+        FReadScopeLock ReadLock(CoalesceKeyFieldsLock);
+        Table = CoalesceKeyFields;
+    }
+    const TArray<UTF8CHAR>* KeyField = Table.IsValid() ? Table->Find(Entry.TypeId) : nullptr;
+    if (!KeyField)
+    {
+        return false;
+    }
+
+    // 没有键字段时整个类型共用一个键
+    OutKey = 0;
+    if (KeyField->Num() == 0)
+    {
+        return true;
+    }
+    const FUtf8StringView Key(KeyField->GetData(), KeyField->Num());
+
+    // 以下都直接在接收缓冲区的UTF-8字节上取键，不转换为FString
+    if (Entry.Envelope.IsSet())
+    {
+        const FMessagePayloadView& Data = Entry.Envelope->Payload;
+        return HashJsonTextField(CoalesceKeyDocument, Data.GetData(), Data.Num(), Key, OutKey);
+    }
+
+    if (ActiveCodec == ENetworkMessageCodec::Protobuf)
+    {
+        const uint8* Data = nullptr;
+        int32 DataLength = 0;
+        return FProtobufEnvelopeCodec::FindPayload(Entry.Payload.GetData(), Entry.Payload.Num(), Data, DataLength)
+            && HashJsonTextField(CoalesceKeyDocument, Data, DataLength, Key, OutKey);
+    }
+
+    const FDecodedPayload* Decoded = Entry.Decoded.Get();
+    if (!Decoded || !Decoded->bParsed)
+    {
+        return false;
+    }
+
+    // JsonRawData编码中Data是嵌入的对象，直接在已解析的文档上查找
+    const FJsonOnDemandValue Data = Decoded->Document.GetRoot().FindField(UTF8TEXTVIEW("Data"));
+    if (Data.GetType() == EJsonOnDemandType::Object)
+    {
+        return HashJsonObjectField(Data, Key, OutKey);
+    }
+
+    // Json编码中是转义后的字符串：没有转义时直接解析源字节，否则反转义到暂存区
+    FUtf8StringView DataText;
+    if (!Data.GetUtf8String(CoalesceKeyScratch, DataText))
+    {
+        return false;
+    }
+    return HashJsonTextField(CoalesceKeyDocument, reinterpret_cast<const uint8*>(DataText.GetData()), DataText.Len(), Key, OutKey);
+}
+
+void UTCPCommunicationSubsystem::DecodeInboxEntry(FInboxEntry& Entry)
+{
+    TSharedRef<FDecodedPayload, ESPMode::ThreadSafe> Decoded = MakeShared<FDecodedPayload, ESPMode::ThreadSafe>();
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    if (ActiveCodec == ENetworkMessageCodec::Protobuf)
+    {
+        Decoded->bParsed = DecodeMessage(Entry.Payload.GetData(), Entry.Payload.Num(), ActiveCodec, Decoded->Message);
+        Decoded->bHasMessage = Decoded->bParsed;
+    }
+    else
+    {
+        // 只有可能需要FNetworkMessage时才在工作线程上转换字符串，否则游戏线程直接读取文档
+        Decoded->bParsed = Decoded->Document.Parse(Entry.Payload.GetData(), Entry.Payload.Num());
+        const bool bWantsMessage = Entry.TypeId == FMessageTypeRegistry::InvalidId
+            || bHasCatchAllHandlers.load(std::memory_order_relaxed) || SubscribedMessageTypes.Contains(Entry.TypeId)
+            || RpcResponseTypes.Contains(Entry.TypeId);
+        if (Decoded->bParsed && bWantsMessage)
+        {
+            Decoded->bHasMessage = ReadJsonMessage(Decoded->Document.GetRoot(), Decoded->Message);
+        }
+    }
+    DecodeStats.AddMessage(Entry.Payload.Num(), FPlatformTime::Cycles64() - StartCycles);
+    Entry.Decoded = Decoded;
+}
+
+bool UTCPCommunicationSubsystem::SplitBatchFrame(const FMessagePayloadView& Batch, TArray<FTypedMessagePayload>& OutMessages)
+{
+    // 原地切分批量帧，每条消息是同一缓冲区上的子视图
+    const uint8* BatchData = Batch.GetData();
+    int32 Offset = 0;
+    while (Offset < Batch.Num())
+    {
+        if (Batch.Num() - Offset < MessageProtocol::BatchLengthPrefixSize)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Truncated length prefix in batch frame (offset %d of %d)"), Offset, Batch.Num());
+            return false;
+        }
+
+        uint32 NetworkLength;
+        FMemory::Memcpy(&NetworkLength, BatchData + Offset, sizeof(NetworkLength));
+        const uint32 Prefix = FEndianConverter::NetworkToHost32(NetworkLength);
+        const uint32 MessageLength = Prefix & MessageProtocol::BatchLengthMask;
+        const uint16 TypeId = (uint16)(Prefix >> MessageProtocol::BatchTypeIdShift);
+        Offset += MessageProtocol::BatchLengthPrefixSize;
+
+        if (MessageLength > (uint32)(Batch.Num() - Offset))
+        {
+            UE_LOG(LogTemp, Error, TEXT("Batch entry length %u exceeds frame (offset %d of %d)"), MessageLength, Offset, Batch.Num());
+            return false;
+        }
+
+        if (MessageLength > 0)
+        {
+            OutMessages.Add(FTypedMessagePayload{ Batch.Slice(Offset, MessageLength), TypeId });
+        }
+        Offset += MessageLength;
+    }
+    return true;
+}
+
+void UTCPCommunicationSubsystem::ProcessReceivedBatch(FMessagePayloadView Batch)
+{
+    // 在接收线程切分批量帧，并在解码之前按类型ID丢弃消息
+    TArray<FTypedMessagePayload> Messages;
+    if (!SplitBatchFrame(Batch, Messages))
+    {
+        return;
+    }
+
+    // 逐条处理，游戏线程的预算可以在批次中间截断
+    for (FTypedMessagePayload& Message : Messages)
+    {
+        if (IsMessageTypeWanted(Message.TypeId))
+        {
+            ProcessReceivedData(MoveTemp(Message.Payload), Message.TypeId);
+        }
+    }
+}
+
+void UTCPCommunicationSubsystem::ProcessReceivedEnvelopes(EFrameType FrameType, FMessagePayloadView Frame, uint16 TypeId)
+{
+    TArray<FTypedMessagePayload> Messages;
+    if (FrameType == EFrameType::Batch)
+    {
+        if (!SplitBatchFrame(Frame, Messages))
+        {
+            return;
+        }
+        Messages.RemoveAll([this](const FTypedMessagePayload& Message) { return !IsMessageTypeWanted(Message.TypeId); });
+    }
+    else if (Frame.Num() > 0)
+    {
+        Messages.Add(FTypedMessagePayload{ MoveTemp(Frame), TypeId });
+    }
+
+    for (const FTypedMessagePayload& Message : Messages)
+    {
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        FNetworkEnvelopeView Envelope;
+        const bool bDecoded = FUpbEnvelopeDecoder::Decode(Message.Payload, Envelope);
+        DecodeStats.AddMessage(Message.Payload.Num(), FPlatformTime::Cycles64() - StartCycles);
+        if (!bDecoded)
+        {
+            continue;
+        }
+
+        // 信封中有类型名，头部没有类型ID的消息也能交给非游戏线程订阅者
+        const uint16 EnvelopeTypeId = FMessageTypeRegistry::MakeId(Envelope.Type);
+        DispatchToWorkerSubscribers(EnvelopeTypeId, [&Envelope](FNetworkMessage& OutMessage)
+        {
+            OutMessage = Envelope.ToMessage();
+            return true;
+        });
+        if (!IsMessageTypeWantedOnGameThread(EnvelopeTypeId))
+        {
+            continue;
+        }
+
+        FInboxEntry Entry;
+        Entry.TypeId = EnvelopeTypeId;
+        Entry.Envelope.Emplace(MoveTemp(Envelope));
+        if (CoalescedMessageTypes.Contains(EnvelopeTypeId))
+        {
+            Entry.bCoalesce = GetCoalesceKey(Entry, Entry.CoalesceKey);
+        }
+        Inbox.Enqueue(MoveTemp(Entry));
+    }
+}
+
+void UTCPCommunicationSubsystem::RegisterInboxTick(UWorld* World)
+{
+    if (!World || !World->PersistentLevel || World->bIsTearingDown)
+    {
+        // 核心Ticker继续分发，等本游戏实例的World初始化后再注册
+        UE_LOG(LogTemp, Log, TEXT("No world to register the inbox tick, dispatching received messages from the core ticker"));
+        return;
+    }
+
+    // TickGroup只在注册时生效，每次连接按当前参数重新注册
+    InboxTickFunction.UnRegisterTickFunction();
+    InboxTickFunction.Subsystem = this;
+    InboxTickFunction.bCanEverTick = true;
+    InboxTickFunction.bTickEvenWhenPaused = true;
+    InboxTickFunction.TickGroup = Settings.InboxTickGroup;
+    InboxTickFunction.RegisterTickFunction(World->PersistentLevel);
+    InboxTickWorld = World;
+}
+
+void UTCPCommunicationSubsystem::HandlePostWorldInitialization(UWorld* World, const UWorld::InitializationValues IVS)
+{
+    // 编辑器中可能同时存在其他游戏实例的World，只跟随自己的
+    if (World && World->GetGameInstance() == GetGameInstance())
+    {
+        RegisterInboxTick(World);
+    }
+}
+
+void UTCPCommunicationSubsystem::HandleWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+    // Tick函数挂在即将销毁的持久关卡上，必须在关卡销毁前注销
+    if (World && World == InboxTickWorld.Get())
+    {
+        InboxTickFunction.UnRegisterTickFunction();
+        InboxTickWorld.Reset();
+    }
+}
+
+bool UTCPCommunicationSubsystem::DrainInboxWithoutWorld(float DeltaTime)
+{
+    if (InboxTickFunction.IsTickFunctionRegistered())
+    {
+        return true;
+    }
+
+    // World初始化时GameInstance可能还没有设置，这里再尝试一次
+    UWorld* World = GetWorld();
+    if (World && World->bIsWorldInitialized && !World->bIsTearingDown)
+    {
+        RegisterInboxTick(World);
+        if (InboxTickFunction.IsTickFunctionRegistered())
+        {
+            return true;
+        }
+    }
+
+    DrainInbox();
+    return true;
+}
+
+void UTCPCommunicationSubsystem::DrainInbox()
+{
+    SCOPE_CYCLE_COUNTER(STAT_MessageMangerDrainInbox);
+
+    const uint64 BudgetCycles = Settings.InboxBudgetMs > 0.0f
+        ? (uint64)(Settings.InboxBudgetMs / 1000.0 / FPlatformTime::GetSecondsPerCycle64())
+        : 0;
+    const int32 Dispatched = Inbox.Drain(BudgetCycles, [this](FInboxEntry& Entry)
+    {
+        if (Entry.Envelope.IsSet())
+        {
+            DispatchEnvelope(Entry.Envelope.GetValue());
+        }
+        else
+        {
+            DispatchPayload(Entry.Payload, Entry.TypeId, Entry.Decoded.Get());
+        }
+    });
+
+    INC_DWORD_STAT_BY(STAT_MessageMangerInboxDispatched, Dispatched);
+    SET_DWORD_STAT(STAT_MessageMangerInboxDepth, Inbox.Num());
+}
+
+void FTCPInboxTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+    if (Subsystem)
+    {
+        Subsystem->DrainInbox();
+    }
+}
+
+FString FTCPInboxTickFunction::DiagnosticMessage()
+{
+    return TEXT("UTCPCommunicationSubsystem::DrainInbox");
+}
+
+void UTCPCommunicationSubsystem::DispatchPayload(const FMessagePayloadView& Payload, uint16 TypeId, const FDecodedPayload* Decoded)
+{
+    // 原始字节处理器直接读取缓冲区
+    if (MessagePayloadDelegate.IsBound())
+    {
+        MessagePayloadDelegate.Execute(Payload);
+    }
+
+    // 无人订阅的类型不解码（接收线程已经过滤过一次，这里处理期间退订的情况）
+    // 心跳ID也可能是冲突的其他类型，需要解码后比较类型名
+    if (TypeId != FMessageTypeRegistry::InvalidId && TypeId != MessageTypeIds::Heartbeat && !bHasCatchAllHandlers
+        && FindSubscribedTypeIndex(TypeId) == INDEX_NONE && !RpcResponseTypes.Contains(TypeId))
+    {
+        return;
+    }
+
+    if (ActiveCodec != ENetworkMessageCodec::Protobuf)
+    {
+        DispatchJsonPayload(Payload, TypeId, Decoded);
+        return;
+    }
+
+    // 工作线程已经解码
+    if (Decoded)
+    {
+        if (Decoded->bHasMessage)
+        {
+            BroadcastMessage(Decoded->Message);
+        }
+        return;
+    }
+
+    // 按当前连接的编码方式解码消息
+    FNetworkMessage NetworkMessage;
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    const bool bDecoded = DecodeMessage(Payload.GetData(), Payload.Num(), ActiveCodec, NetworkMessage);
+    DecodeStats.AddMessage(Payload.Num(), FPlatformTime::Cycles64() - StartCycles);
+    if (bDecoded)
+    {
+        BroadcastMessage(NetworkMessage);
+    }
+}
+
+void UTCPCommunicationSubsystem::DispatchJsonPayload(const FMessagePayloadView& Payload, uint16 TypeId, const FDecodedPayload* Decoded)
+{
+    // 工作线程已经建立结构索引时直接使用其文档
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    const bool bParsed = Decoded ? Decoded->bParsed : JsonDocument.Parse(Payload.GetData(), Payload.Num());
+    if (!bParsed)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to deserialize message: %s"), *UMessageMangerBPLibrary::ConvertUtf8BinaryToString(Payload.GetData(), Payload.Num()));
+        return;
+    }
+    const FJsonOnDemandValue Root = Decoded ? Decoded->Document.GetRoot() : JsonDocument.GetRoot();
+    if (!Decoded)
+    {
+        DecodeStats.AddMessage(Payload.Num(), FPlatformTime::Cycles64() - StartCycles);
+    }
+
+    if (JsonMessageDelegate.IsBound())
+    {
+        JsonMessageDelegate.Execute(Payload, Root);
+    }
+
+    // 头部没有类型ID时（旧版本对端）按UTF-8类型名计算；分发前用类型名排除ID冲突，都不转换字符串
+    FUtf8StringView Type;
+    Root.FindField(UTF8TEXTVIEW("Type")).GetRawString(Type);
+    if (TypeId == FMessageTypeRegistry::InvalidId)
+    {
+        TypeId = FMessageTypeRegistry::MakeId(Type);
+    }
+    if (MessageTypeIds::IsHeartbeat(TypeId, Type))
+    {
+        HandleHeartbeat();
+        return;
+    }
+
+    // RPC响应只交给等待的调用
+    bool bIsResponse = false;
+    if (Root.FindField(UTF8TEXTVIEW("Response")).GetBool(bIsResponse) && bIsResponse)
+    {
+        FNetworkMessage Response;
+        if (Decoded && Decoded->bHasMessage)
+        {
+            Response = Decoded->Message;
+        }
+        else if (!ReadJsonMessage(Root, Response))
+        {
+            return;
+        }
+        CompleteRpcCall(Response);
+        return;
+    }
+
+    // 只有该类型有订阅者或注册了消息回调时才转换为FNetworkMessage
+    FOnTypedMessageReceived* Subscribers = FindTypeSubscribers(TypeId, Type);
+    if (!Subscribers && !MessageReceivedDelegate.IsBound())
+    {
+        return;
+    }
+
+    if (Decoded && Decoded->bHasMessage)
+    {
+        DeliverMessage(Decoded->Message, Subscribers);
+        return;
+    }
+
+    FNetworkMessage NetworkMessage;
+    if (ReadJsonMessage(Root, NetworkMessage))
+    {
+        DeliverMessage(NetworkMessage, Subscribers);
+    }
+}
+
+void UTCPCommunicationSubsystem::DispatchEnvelope(const FNetworkEnvelopeView& Envelope)
+{
+    if (MessagePayloadDelegate.IsBound())
+    {
+        MessagePayloadDelegate.Execute(Envelope.Source);
+    }
+
+    if (EnvelopeReceivedDelegate.IsBound())
+    {
+        EnvelopeReceivedDelegate.Execute(Envelope);
+    }
+
+    // 按UTF-8类型名计算类型ID，不转换字符串
+    const uint16 TypeId = FMessageTypeRegistry::MakeId(Envelope.Type);
+    if (MessageTypeIds::IsHeartbeat(TypeId, Envelope.Type))
+    {
+        HandleHeartbeat();
+        return;
+    }
+
+    // RPC响应只交给等待的调用
+    if (Envelope.bIsResponse)
+    {
+        CompleteRpcCall(Envelope.ToMessage());
+        return;
+    }
+
+    // 只有该类型有订阅者或注册了消息回调时才转换为FNetworkMessage
+    FOnTypedMessageReceived* Subscribers = FindTypeSubscribers(TypeId, Envelope.Type);
+    if (Subscribers || MessageReceivedDelegate.IsBound())
+    {
+        DeliverMessage(Envelope.ToMessage(), Subscribers);
+    }
+}
+
+void UTCPCommunicationSubsystem::BroadcastMessage(const FNetworkMessage& NetworkMessage)
+{
+    // 处理心跳消息
+    const uint16 TypeId = FMessageTypeRegistry::MakeId(NetworkMessage.MessageType);
+    if (MessageTypeIds::IsHeartbeat(TypeId, NetworkMessage.MessageType))
+    {
+        HandleHeartbeat();
+        return;
+    }
+    if (NetworkMessage.bIsResponse)
+    {
+        CompleteRpcCall(NetworkMessage);
+        return;
+    }
+    DeliverMessage(NetworkMessage, FindTypeSubscribers(TypeId, NetworkMessage.MessageType));
+}
+
+TFuture<FRpcResult> UTCPCommunicationSubsystem::CallRemote(const FNetworkMessage& Request, float TimeoutSeconds, const FString& ResponseType)
+{
+    if (!bIsConnected || !Socket.IsValid())
+    {
+        return MakeFulfilledPromise<FRpcResult>(FRpcResult{ ERpcStatus::Disconnected }).GetFuture();
+    }
+
+    TFuture<FRpcResult> Future;
+    const uint64 CorrelationId = RpcCalls.Add(GetRpcDeadlineCycles(TimeoutSeconds), Future);
+    if (CorrelationId == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Too many RPC calls in flight (%d), rejecting %s"), RpcCalls.Num(), *Request.MessageType);
+        return MakeFulfilledPromise<FRpcResult>(FRpcResult{ ERpcStatus::TooManyCalls }).GetFuture();
+    }
+
+    SendRpcRequest(Request, CorrelationId, ResponseType);
+    return Future;
+}
+
+void UTCPCommunicationSubsystem::CallRemote(const FNetworkMessage& Request, FRpcWaiter& Waiter, float TimeoutSeconds, const FString& ResponseType)
+{
+    if (!bIsConnected || !Socket.IsValid())
+    {
+        Waiter.OnRpcComplete(FRpcResult{ ERpcStatus::Disconnected });
+        return;
+    }
+
+    const uint64 CorrelationId = RpcCalls.Add(GetRpcDeadlineCycles(TimeoutSeconds), Waiter);
+    if (CorrelationId == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Too many RPC calls in flight (%d), rejecting %s"), RpcCalls.Num(), *Request.MessageType);
+        Waiter.OnRpcComplete(FRpcResult{ ERpcStatus::TooManyCalls });
+        return;
+    }
+
+    SendRpcRequest(Request, CorrelationId, ResponseType);
+}
+
+uint64 UTCPCommunicationSubsystem::GetRpcDeadlineCycles(float TimeoutSeconds) const
+{
+    const double Timeout = TimeoutSeconds > 0.0f ? TimeoutSeconds : Settings.RpcTimeoutSeconds;
+    return FPlatformTime::Cycles64() + (uint64)(Timeout / FPlatformTime::GetSecondsPerCycle64());
+}
+
+void UTCPCommunicationSubsystem::SendRpcRequest(const FNetworkMessage& Request, uint64 CorrelationId, const FString& ResponseType)
+{
+    // 响应类型需要通过接收线程的类型过滤
+    RpcResponseTypes.Set(FMessageTypeRegistry::MakeId(ResponseType.IsEmpty() ? Request.MessageType : ResponseType), true);
+
+    FNetworkMessage Message = Request;
+    Message.CorrelationId = (int64)CorrelationId;
+    Message.bIsResponse = false;
+    if (!SendMessage(Message))
+    {
+        RpcCalls.Complete(CorrelationId, FRpcResult{ ERpcStatus::SendFailed });
+    }
+}
+
+bool UTCPCommunicationSubsystem::SendResponse(const FNetworkMessage& Request, const FNetworkMessage& Response)
+{
+    FNetworkMessage Message = Response;
+    Message.CorrelationId = Request.CorrelationId;
+    Message.bIsResponse = true;
+    return SendMessage(Message);
+}
+
+bool UTCPCommunicationSubsystem::ExpireRpcDeadlines(float DeltaTime)
+{
+    if (RpcCalls.Num() > 0)
+    {
+        RpcCalls.ExpireDeadlines(FPlatformTime::Cycles64());
+    }
+    return true;
+}
+
+void UTCPCommunicationSubsystem::CompleteRpcCall(const FNetworkMessage& Response)
+{
+    if (!RpcCalls.Complete((uint64)Response.CorrelationId, FRpcResult{ ERpcStatus::Ok, Response }))
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("Dropped RPC response %lld (%s): call already timed out or unknown"), Response.CorrelationId, *Response.MessageType);
+    }
+}
+
+void UTCPCommunicationSubsystem::DeliverMessage(const FNetworkMessage& NetworkMessage, FOnTypedMessageReceived* Subscribers)
+{
+    // 先按类型广播给订阅者，再交给全量消息回调
+    if (Subscribers)
+    {
+        Subscribers->Broadcast(NetworkMessage);
+    }
+    if (MessageReceivedDelegate.IsBound())
+    {
+        MessageReceivedDelegate.Execute(NetworkMessage);
+    }
+}
+
+void UTCPCommunicationSubsystem::NotifyConnectionStatusChanged(bool bNewConnected)
+{
+    AsyncTask(ENamedThreads::GameThread, [this, bNewConnected]()
+    {
+        if (ConnectionStatusDelegate.IsBound())
+        {
+            ConnectionStatusDelegate.Execute(bNewConnected);
+        }
+    });
+}
+
+// 接收线程实现
+uint32 FReceiveWorker::Run()
+{
+    if (!Socket.IsValid() || !Subsystem)
+    {
+        return 1;
+    }
+
+    // 等待可读的超时时间(毫秒)
+    const int32 WAIT_TIMEOUT_MS = 100;
+
+    // 用于缓存分片数据的结构
+    struct FPartialMessage
+    {
+        FMessageBufferRef Data;      // 完整数据缓冲区（引用计数，完成后直接交给处理函数）
+        int32 ReceivedChunks;       // 已接收的分片数
+        int32 TotalChunks;          // 总分片数
+        FDateTime LastActivityTime; // 最后活动时间，用于超时处理
+    };
+
+    // 存储所有部分接收的消息 (MessageId -> 部分消息)
+    TMap<uint32, FPartialMessage> PartialMessages;
+
+    // 增量分片解码器，处理TCP的拆包与粘包
+    FFrameDecoder Decoder(256 * 1024, Settings.MaxMessageSize);
+
+    // 用内核接收时间戳统计唤醒延迟
+    const bool bMeasureWakeLatency = Settings.bMeasureReceiveWakeLatency && FFrameDecoder::EnableArrivalTimestamps(*Socket);
+
+    UE_LOG(LogTemp, Log, TEXT("Receive worker started with chunking (max %d bytes per chunk)"), MessageProtocol::MaxChunkSize);
+
+    // upb解码模式下在本线程解码信封
+    const bool bUpbDecode = Settings.MessageCodec == ENetworkMessageCodec::Protobuf && Settings.bUpbArenaDecode;
+
+    // 交付一个完整的帧负载
+    auto DeliverFrame = [this, bUpbDecode](const FChunkHeader& Header, FMessagePayloadView Payload)
+    {
+        if (bUpbDecode)
+        {
+            Subsystem->ProcessReceivedEnvelopes(Header.FrameType, MoveTemp(Payload), Header.MessageTypeId);
+        }
+        else if (Header.FrameType == EFrameType::Batch)
+        {
+            Subsystem->ProcessReceivedBatch(MoveTemp(Payload));
+        }
+        else
+        {
+            Subsystem->ProcessReceivedData(MoveTemp(Payload), Header.MessageTypeId);
+        }
+    };
+
+    // 处理一个完整分片
+    auto HandleChunk = [this, &PartialMessages, &DeliverFrame](const FChunkHeader& Header, const uint8* ChunkData, int32 ChunkSize, uint64 WakeCycles)
+    {
+        UE_LOG(LogTemp, Verbose, TEXT("Received chunk %d (MessageId: %u, size: %d bytes)"),
+            Header.ChunkIndex, Header.MessageId, ChunkSize);
+
+        // 被丢弃或无人订阅的类型不复制、不重组，每个分片头部都带有类型ID
+        // 这里只看ID，与订阅类型ID冲突的消息会通过，分发前按类型名排除
+        if (Header.FrameType == EFrameType::Message && !Subsystem->IsMessageTypeWanted(Header.MessageTypeId))
+        {
+            PartialMessages.Remove(Header.MessageId);
+            return;
+        }
+
+        // 单分片消息：从环形缓冲区复制一次后直接交给处理函数，不进入重组表
+        if (Header.ChunkIndex == 0 && Header.IsLastChunk && (uint32)ChunkSize == Header.TotalLength)
+        {
+            FMessageBufferRef Buffer = FMessagePayloadView::AllocateBuffer(ChunkSize);
+            FMemory::Memcpy(Buffer->GetData(), ChunkData, ChunkSize);
+            DeliverFrame(Header, FMessagePayloadView(Buffer));
+            Subsystem->ReceiveProcessLatency.AddCycles(FPlatformTime::Cycles64() - WakeCycles);
+            return;
+        }
+
+        // 检查是否是新消息
+        FPartialMessage* CurrentMessage = PartialMessages.Find(Header.MessageId);
+        if (!CurrentMessage)
+        {
+            // 初始化新的部分消息，一次性分配完整大小
+            FPartialMessage NewMessage{ FMessagePayloadView::AllocateBuffer(Header.TotalLength) };
+            NewMessage.ReceivedChunks = 0;
+            NewMessage.TotalChunks = Header.GetTotalChunks();
+            NewMessage.LastActivityTime = FDateTime::UtcNow();
+
+            CurrentMessage = &PartialMessages.Add(Header.MessageId, MoveTemp(NewMessage));
+        }
+
+        // 验证分片有效性
+        if (Header.ChunkIndex >= (uint32)CurrentMessage->TotalChunks || Header.TotalLength != (uint32)CurrentMessage->Data->Num())
+        {
+            UE_LOG(LogTemp, Error, TEXT("Invalid chunk index %d for message %u (total chunks: %d)"),
+                Header.ChunkIndex, Header.MessageId, CurrentMessage->TotalChunks);
+            PartialMessages.Remove(Header.MessageId);
+            return;
+        }
+
+        // 将分片数据从环形缓冲区直接复制到最终缓冲区
+        const int32 ChunkOffset = Header.ChunkIndex * MessageProtocol::MaxChunkSize;
+        FMemory::Memcpy(CurrentMessage->Data->GetData() + ChunkOffset, ChunkData, ChunkSize);
+        CurrentMessage->ReceivedChunks++;
+        CurrentMessage->LastActivityTime = FDateTime::UtcNow();
+
+        // 检查是否接收完所有分片
+        if (Header.IsLastChunk && CurrentMessage->ReceivedChunks == CurrentMessage->TotalChunks)
+        {
+            UE_LOG(LogTemp, Verbose, TEXT("Message %u fully received (%d bytes)"),
+                Header.MessageId, CurrentMessage->Data->Num());
+
+            // 将完整数据传递给处理函数
+            DeliverFrame(Header, FMessagePayloadView(CurrentMessage->Data));
+            Subsystem->ReceiveProcessLatency.AddCycles(FPlatformTime::Cycles64() - WakeCycles);
+
+            // 从缓存中移除
+            PartialMessages.Remove(Header.MessageId);
+        }
+    };
+
+    while (!bStopRequested && Subsystem->IsConnected() && Socket.IsValid())
+    {
+        // 阻塞等待Socket可读，断开连接时Shutdown会立即唤醒
+        // 超时只用于定期清理过期的部分消息，空闲时不占用CPU
+        if (Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(WAIT_TIMEOUT_MS)))
+        {
+            // 处理延迟的起点：线程已被唤醒，之后的读取、重组和分发都计入
+            const uint64 WakeCycles = FPlatformTime::Cycles64();
+
+            // 唤醒延迟：每次唤醒前队列已读空，队列中最早的数据就是唤醒本线程的数据
+            int64 ArrivalAgeNanos = 0;
+            if (bMeasureWakeLatency && FFrameDecoder::PeekArrivalAge(*Socket, ArrivalAgeNanos))
+            {
+                Subsystem->ReceiveWakeLatency.AddSample((uint64)ArrivalAgeNanos / 1000);
+            }
+
+            // 读取内核中所有可用数据，并切出其中的每个完整分片
+            FFrameDecoder::EReadResult ReadResult;
+            bool bStreamValid = true;
+            do
+            {
+                int32 BytesRead = 0;
+                ReadResult = Decoder.ReadFromSocket(*Socket, BytesRead);
+                bStreamValid = Decoder.ExtractFrames([&HandleChunk, WakeCycles](const FChunkHeader& Header, const uint8* Payload, int32 PayloadSize)
+                {
+                    HandleChunk(Header, Payload, PayloadSize, WakeCycles);
+                });
+            } while (bStreamValid && ReadResult == FFrameDecoder::EReadResult::BufferFull);
+
+            if (ReadResult == FFrameDecoder::EReadResult::Closed && !Subsystem->IsConnected())
+            {
+                // 本地主动断开，Shutdown唤醒了等待
+                break;
+            }
+
+            if (!bStreamValid || ReadResult == FFrameDecoder::EReadResult::Closed)
+            {
+                // 接收失败或字节流已损坏，断开连接
+                UE_LOG(LogTemp, Error, TEXT("Failed to receive data"));
+
+                AsyncTask(ENamedThreads::GameThread, [this]()
+                {
+                        Subsystem->Disconnect();
+                });
+                break;
+            }
+        }
+
+        // 清理超时的部分消息（5秒超时）
+        TArray<uint32> ExpiredMessages;
+        for (const auto& Pair : PartialMessages)
+        {
+            if (FDateTime::UtcNow() - Pair.Value.LastActivityTime > FTimespan::FromSeconds(5))
+            {
+                ExpiredMessages.Add(Pair.Key);
+            }
+        }
+        for (uint32 MsgId : ExpiredMessages)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Message %u expired (incomplete chunks)"), MsgId);
+            PartialMessages.Remove(MsgId);
+        }
+    }
+
+    UE_LOG(LogTemp, Log, TEXT("Receive worker stopped, processing latency: %s"), *Subsystem->ReceiveProcessLatency.Snapshot().ToString());
+    if (bMeasureWakeLatency)
+    {
+        UE_LOG(LogTemp, Log, TEXT("Receive wake latency: %s"), *Subsystem->ReceiveWakeLatency.Snapshot().ToString());
+    }
+    return 0;
+}
+
+// 发送线程实现
+uint32 FSendWorker::Run()
+{
+    if (!Socket.IsValid() || !Subsystem)
+    {
+        return 1;
+    }
+
+    // 定义最大分片大小为64KB (65536字节)
+    const int32 MAX_CHUNK_SIZE = MessageProtocol::MaxChunkSize;
+
+    // 等待Socket可写的超时时间(毫秒)
+    const int32 WRITABLE_TIMEOUT_MS = 100;
+
+    // 合并发送参数
+    const bool bCoalesce = Settings.bCoalesceSends;
+    const uint64 CoalesceWindowCycles = (uint64)(Settings.CoalesceWindowMicros / (1000000.0 * FPlatformTime::GetSecondsPerCycle64()));
+
+    // 多分片帧每次写出的字节数和分片数上限
+    const int32 LargeFrameWriteBytes = FMath::Max(Settings.LargeFrameWriteBytes, Settings.CoalesceByteThreshold);
+    const int32 MaxChunksPerWrite = FSocketGatherWriter::GetMaxChunksPerWrite();
+
+    // 分片聚合写入器，一批分片一次系统调用写出
+    FSocketGatherWriter Writer(*Socket, Settings.ZeroCopyThreshold);
+
+    UE_LOG(LogTemp, Log, TEXT("Send worker started with chunking (max %d bytes per chunk, coalescing %s)"),
+        MAX_CHUNK_SIZE, bCoalesce ? TEXT("on") : TEXT("off"));
+
+    // 已进入写入器但尚未交给send()的消息的入队时间
+    TArray<uint64> UnflushedEnqueueCycles;
+
+    // 合并窗口内第一条消息进入写入器的时间，0表示窗口为空
+    uint64 WindowStartCycles = 0;
+
+    // 上次写出遇到内核发送缓冲区已满
+    bool bWaitingWritable = false;
+    bool bSocketError = false;
+
+    // 一个正在分片发送的帧
+    struct FOutgoingFrame
+    {
+        FMessageBufferRef Payload;
+        EFrameType FrameType;
+        uint16 TypeId;
+        uint32 MessageId;
+        int32 NextChunkIndex;
+        int32 TotalChunks;
+        uint64 EnqueueCycles;
+    };
+
+    // 每个优先级通道最多一个正在发送的多分片帧，通道内的后续消息等它发完，保证同一通道内的顺序
+    TOptional<FOutgoingFrame> ActiveFrames[FSendQueue::NumLanes];
+
+    // 优先级最高的正在发送的帧所在的通道，没有时返回通道数
+    auto FirstActiveLane = [&ActiveFrames]()
+    {
+        int32 Lane = 0;
+        while (Lane < FSendQueue::NumLanes && !ActiveFrames[Lane].IsSet())
+        {
+            ++Lane;
+        }
+        return Lane;
+    };
+
+    // 消息ID单调递增，不同通道的分片交错发送时接收端按ID区分
+    uint32 NextMessageId = 1;
+
+    // 消息发送序号，每个连接从1开始
+    uint64 NextSequence = 1;
+
+    auto MakeFrame = [&NextMessageId, MAX_CHUNK_SIZE](const FMessageBufferRef& Payload, EFrameType FrameType, uint16 TypeId, uint64 EnqueueCycles)
+    {
+        const int32 TotalDataLength = Payload->Num();
+        const int32 TotalChunks = FMath::DivideAndRoundUp(TotalDataLength, MAX_CHUNK_SIZE);
+        UE_LOG(LogTemp, Verbose, TEXT("Sending frame as %d chunks (total %d bytes)"), TotalChunks, TotalDataLength);
+        return FOutgoingFrame{ Payload, FrameType, TypeId, NextMessageId++, 0, TotalChunks, EnqueueCycles };
+    };
+
+    // 将帧的下MaxChunks个分片交给写入器：头部和负载切片分别交给写入器，不再拼接到临时缓冲区
+    // 返回帧是否已全部交给写入器
+    auto AddFrameChunks = [&Writer, MAX_CHUNK_SIZE](FOutgoingFrame& Frame, int32 MaxChunks)
+    {
+        const int32 TotalDataLength = Frame.Payload->Num();
+        const int32 EndChunk = FMath::Min(Frame.TotalChunks, Frame.NextChunkIndex + MaxChunks);
+        for (; Frame.NextChunkIndex < EndChunk; Frame.NextChunkIndex++)
+        {
+            // 计算当前分片的偏移量和大小
+            const int32 ChunkOffset = Frame.NextChunkIndex * MAX_CHUNK_SIZE;
+            const int32 ChunkSize = FMath::Min(MAX_CHUNK_SIZE, TotalDataLength - ChunkOffset);
+
+            // 构建分片头部
+            FChunkHeader Header;
+            Header.MessageId = Frame.MessageId;
+            Header.TotalLength = TotalDataLength;
+            Header.ChunkIndex = Frame.NextChunkIndex;
+            Header.IsLastChunk = (Frame.NextChunkIndex == Frame.TotalChunks - 1) ? 1 : 0;
+            Header.FrameType = Frame.FrameType;
+            Header.MessageTypeId = Frame.TypeId;
+
+            Writer.AddChunk(Header, Frame.Payload, ChunkOffset, ChunkSize);
+        }
+        return Frame.NextChunkIndex >= Frame.TotalChunks;
+    };
+
+    // 编码输出和批量帧复用的缓冲区，写入器释放引用后回到池中
+    FMessageBufferPool BufferPool;
+
+    // 正在打包的批量帧（只包含单个分片能容纳的消息）
+    TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> BatchBuffer;
+
+    // 结束当前批量帧并交给写入器
+    auto CloseBatch = [&BatchBuffer, &MakeFrame, &AddFrameChunks]()
+    {
+        if (BatchBuffer.IsValid())
+        {
+            FOutgoingFrame Frame = MakeFrame(BatchBuffer.ToSharedRef(), EFrameType::Batch, FMessageTypeRegistry::InvalidId, 0);
+            AddFrameChunks(Frame, 1);
+            BatchBuffer.Reset();
+        }
+    };
+
+    // 写出写入器中的所有数据
+    auto FlushWriter = [this, &Writer, &CloseBatch, &UnflushedEnqueueCycles, &WindowStartCycles, &bWaitingWritable, &bSocketError]()
+    {
+        CloseBatch();
+        const FSocketGatherWriter::EFlushResult Result = Writer.Flush();
+        Subsystem->SendThroughput.SetWriteCalls(Writer.GetWriteCalls());
+
+        // 记录从入队到交给send()的延迟
+        const uint64 NowCycles = FPlatformTime::Cycles64();
+        for (uint64 EnqueueCycles : UnflushedEnqueueCycles)
+        {
+            Subsystem->SendLatency.AddCycles(NowCycles - EnqueueCycles);
+        }
+        UnflushedEnqueueCycles.Reset();
+        WindowStartCycles = 0;
+
+        bWaitingWritable = (Result == FSocketGatherWriter::EFlushResult::WouldBlock);
+        if (Result == FSocketGatherWriter::EFlushResult::Error)
+        {
+            bSocketError = true;
+            if (Subsystem->IsConnected())
+            {
+                AsyncTask(ENamedThreads::GameThread, [this]()
                 {
-                    uint32 MessageId;
-                    uint32 TotalLength;
-                    uint32 ChunkIndex;
-                    uint8 IsLastChunk;
-                };
+                        Subsystem->Disconnect();
+                });
+            }
+        }
+    };
+
+    while (!bStopRequested && Subsystem->IsConnected() && Socket.IsValid() && !bSocketError)
+    {
+        // 先续写上次未写完的输出；发送缓冲区仍满时等待可写，期间不再出队（背压）
+        if (bWaitingWritable)
+        {
+            FlushWriter();
+            if (bWaitingWritable)
+            {
+                Socket->Wait(ESocketWaitConditions::WaitForWrite, FTimespan::FromMilliseconds(WRITABLE_TIMEOUT_MS));
+            }
+            continue;
+        }
+
+        // 从队列中获取消息，只取比正在分片发送的帧优先级更高的通道
+        FQueuedMessage Queued;
+        while (!bWaitingWritable && !bSocketError && SendQueue.Dequeue(Queued, FirstActiveLane()))
+        {
+            const FNetworkMessage& Message = Queued.Message;
+
+            // 填写发送序号和发送时间
+            Queued.Message.Sequence = (int64)NextSequence++;
+            if (Settings.MessageCodec == ENetworkMessageCodec::Protobuf)
+            {
+                Queued.Message.SentUnixMicros = FNetworkMessage::GetUtcNowUnixMicros();
+            }
 
-                FChunkHeader Header;
-                Header.MessageId = MessageId;
-                Header.TotalLength = TotalDataLength;
-                Header.ChunkIndex = ChunkIndex;
-                Header.IsLastChunk = (ChunkIndex == TotalChunks - 1) ? 1 : 0;
+            // 编码为线上字节，放入引用计数缓冲区供写入器直接引用
+            FMessageBufferRef OutMsgData = BufferPool.Acquire();
+            const uint64 EncodeStartCycles = FPlatformTime::Cycles64();
+            Subsystem->EncodeMessage(Message, Settings.MessageCodec, *OutMsgData);
+            Subsystem->EncodeStats.AddMessage(OutMsgData->Num(), FPlatformTime::Cycles64() - EncodeStartCycles);
+            int32 TotalDataLength = OutMsgData->Num();
+            // 如果数据为空则跳过
+            if (TotalDataLength <= 0)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("Skipping empty message"));
+                continue;
+            }
+
+            const int32 Lane = FSendQueue::GetLane(Message);
+            const uint16 TypeId = FMessageTypeRegistry::MakeId(Message.MessageType);
+            const int32 BatchEntrySize = MessageProtocol::BatchLengthPrefixSize + TotalDataLength;
+            if (Settings.bEnableBatchFrames && TotalDataLength <= Settings.BatchMessageMaxSize && BatchEntrySize <= MAX_CHUNK_SIZE)
+            {
+                // 小消息追加到批量帧：4字节大端序（类型ID << 16 | 长度） + 消息内容
+                if (BatchBuffer.IsValid() && BatchBuffer->Num() + BatchEntrySize > MAX_CHUNK_SIZE)
+                {
+                    CloseBatch();
+                }
+                if (!BatchBuffer.IsValid())
+                {
+                    BatchBuffer = BufferPool.Acquire();
+                    BatchBuffer->Reserve(FMath::Min(MAX_CHUNK_SIZE, Settings.CoalesceByteThreshold));
+                }
+                const uint32 NetworkLength = FEndianConverter::HostToNetwork32(((uint32)TypeId << MessageProtocol::BatchTypeIdShift) | (uint32)TotalDataLength);
+                BatchBuffer->Append(reinterpret_cast<const uint8*>(&NetworkLength), sizeof(NetworkLength));
+                BatchBuffer->Append(*OutMsgData);
+            }
+            else
+            {
+                // 保证顺序：先结束之前的批量帧，再发送这条独立消息
+                CloseBatch();
+                FOutgoingFrame Frame = MakeFrame(OutMsgData, EFrameType::Message, TypeId, Queued.EnqueueCycles);
+                if (Frame.TotalChunks > 1)
+                {
+                    // 多分片消息逐个分片发送，两个分片之间可以插入更高优先级的消息
+                    Subsystem->SendThroughput.AddMessage(TotalDataLength);
+                    ActiveFrames[Lane].Emplace(MoveTemp(Frame));
+                    continue;
+                }
+                AddFrameChunks(Frame, 1);
+            }
 
-                // 准备发送缓冲区
-                FArrayWriter ChunkData = FArrayWriter(true);
+            Subsystem->SendThroughput.AddMessage(TotalDataLength);
+            UnflushedEnqueueCycles.Add(Queued.EnqueueCycles);
+            if (WindowStartCycles == 0)
+            {
+                WindowStartCycles = FPlatformTime::Cycles64();
+            }
 
-                // 写入头部
-                ChunkData.Serialize(&Header, sizeof(FChunkHeader));
+            // 不合并时每条消息立即写出（批量帧等队列取空后再写出）；合并时累积到字节阈值再写出；控制消息总是立即写出
+            const int32 BufferedBytes = Writer.GetPendingBytes() + (BatchBuffer.IsValid() ? BatchBuffer->Num() : 0);
+            if ((!bCoalesce && !BatchBuffer.IsValid()) || BufferedBytes >= Settings.CoalesceByteThreshold
+                || Message.Priority == ENetworkMessagePriority::Control)
+            {
+                FlushWriter();
+            }
+        }
 
-                // 写入当前分片的数据
-                ChunkData.Serialize((void*)(OutMsgData.GetData() + ChunkOffset), ChunkSize);
+        if (bWaitingWritable || bSocketError)
+        {
+            continue;
+        }
 
-                // 发送当前分片
-                int32 BytesSent = 0;
-                bool bSuccess = Socket->Send(ChunkData.GetData(), ChunkData.Num(), BytesSent);
+        // 更高优先级的通道已空，推进优先级最高的多分片帧，累积到写出字节数或一次写调用的分片上限后
+        // 一次写出，再重新检查队列；更高优先级的消息最多等待一次写出
+        const int32 ActiveLane = FirstActiveLane();
+        if (ActiveLane < FSendQueue::NumLanes)
+        {
+            // 打包中的批量帧只含已出队的更高优先级或更早的消息，先结束它，让它排在本次的分片之前写出
+            CloseBatch();
 
-                if (!bSuccess || BytesSent != ChunkData.Num())
+            FOutgoingFrame& Frame = ActiveFrames[ActiveLane].GetValue();
+            if (Frame.NextChunkIndex == 0)
+            {
+                UnflushedEnqueueCycles.Add(Frame.EnqueueCycles);
+            }
+            while (true)
+            {
+                if (AddFrameChunks(Frame, 1))
                 {
-                    UE_LOG(LogTemp, Error, TEXT("Failed to send chunk %d. Sent %d of %d bytes"),
-                        ChunkIndex, BytesSent, ChunkData.Num());
-                    AsyncTask(ENamedThreads::GameThread, [this]()
-                    {
-                            Subsystem->Disconnect();
-					});
-                    
+                    ActiveFrames[ActiveLane].Reset();
                     break;
                 }
-                else
+                if (Writer.GetPendingBytes() >= LargeFrameWriteBytes || Writer.GetPendingChunks() >= MaxChunksPerWrite)
                 {
-                    UE_LOG(LogTemp, Log, TEXT("Send chunk success %d send %d of %d bytes!"), ChunkIndex, ChunkData.Num(), BytesSent);
+                    break;
                 }
+            }
+            FlushWriter();
+            continue;
+        }
+
+        // 不合并时，队列取空后立即写出批量帧
+        if (!bCoalesce && BatchBuffer.IsValid())
+        {
+            FlushWriter();
+            continue;
+        }
 
-                UE_LOG(LogTemp, Log, TEXT("Sent chunk %d/%d (size: %d bytes)"),
-                    ChunkIndex + 1, TotalChunks, ChunkSize);
+        // 合并窗口：到达截止时间或游戏线程请求帧末写出时写出
+        if (Writer.HasPendingOutput() || BatchBuffer.IsValid())
+        {
+            const uint64 ElapsedCycles = FPlatformTime::Cycles64() - WindowStartCycles;
+            if (Subsystem->bFlushRequested.exchange(false) || ElapsedCycles >= CoalesceWindowCycles)
+            {
+                FlushWriter();
+                continue;
             }
+
+            // 等待新消息、帧末写出请求或窗口截止；FEvent以毫秒计时，剩余窗口向上取整，
+            // 不足1毫秒时按1毫秒挂起而不是忙等，窗口最多延长不到1毫秒
+            const double RemainingMicros = FPlatformTime::ToSeconds64(CoalesceWindowCycles - ElapsedCycles) * 1000000.0;
+            SendEvent->Wait((uint32)FMath::Max(1, FMath::CeilToInt(RemainingMicros / 1000.0)));
+            continue;
         }
 
-        // 短暂休眠，减少CPU占用
-        FPlatformProcess::Sleep(0.001f);
+        // 队列已空，挂起等待SendMessage、FlushSends或Disconnect唤醒
+        Subsystem->bFlushRequested = false;
+        SendEvent->Wait();
     }
 
-    UE_LOG(LogTemp, Log, TEXT("Send worker stopped"));
+    UE_LOG(LogTemp, Log, TEXT("Send worker stopped, enqueue-to-send latency: %s, throughput: %s, encode: %s"),
+        *Subsystem->SendLatency.Snapshot().ToString(), *Subsystem->SendThroughput.Snapshot().ToString(), *Subsystem->EncodeStats.Snapshot().ToString());
+    return 0;
 }
@@ -0,0 +1,166 @@
+﻿#include "UpbEnvelopeDecoder.h"
+#include "MessageMangerBPLibrary.h"
+
+#if WITH_PROTOBUF
+// upb的头文件与UE的check/verify宏冲突
+#pragma push_macro("check")
+#pragma push_macro("verify")
+#undef check
+#undef verify
+THIRD_PARTY_INCLUDES_START
+#include <upb/base/status.h>
+#include <upb/base/string_view.h>
+#include <upb/mem/alloc.h>
+#include <upb/mem/arena.h>
+#include <upb/message/accessors.h>
+#include <upb/message/message.h>
+#include <upb/mini_descriptor/decode.h>
+#include <upb/mini_table/message.h>
+#include <upb/wire/decode.h>
+THIRD_PARTY_INCLUDES_END
+#pragma pop_macro("verify")
+#pragma pop_macro("check")
+
+namespace
+{
+    // NetworkEnvelope的mini-table，进程内构建一次，所在的arena不释放
+    struct FEnvelopeMiniTable
+    {
+        const upb_MiniTable* Table = nullptr;
+        const upb_MiniTableField* Type = nullptr;
+        const upb_MiniTableField* Payload = nullptr;
+        const upb_MiniTableField* Sequence = nullptr;
+        const upb_MiniTableField* CreatedUnixMicros = nullptr;
+        const upb_MiniTableField* SentUnixMicros = nullptr;
+        const upb_MiniTableField* CorrelationId = nullptr;
+        const upb_MiniTableField* IsResponse = nullptr;
+
+        FEnvelopeMiniTable()
+        {
+            // Proto/NetworkEnvelope.proto的mini descriptor（与protoc生成代码中的格式相同）：
+            // '$'开头，每个字段一个类型字符（按字段号升序），'P'表示proto3单值字段
+            // 1 type:string '1'，2 payload:bytes '0'，3 sequence:uint64 ','，4/5 created/sent:int64 '+'，
+            // 6 correlation_id:uint64 ','，7 is_response:bool '/'
+            static const char EnvelopeMiniDescriptor[] = "$1P0P,P+P+P,P/P";
+
+            upb_Status Status;
+            upb_Status_Clear(&Status);
+            Table = upb_MiniTable_Build(EnvelopeMiniDescriptor, sizeof(EnvelopeMiniDescriptor) - 1, upb_Arena_New(), &Status);
+            if (!Table)
+            {
+                UE_LOG(LogTemp, Error, TEXT("Failed to build NetworkEnvelope mini-table: %hs"), upb_Status_ErrorMessage(&Status));
+                return;
+            }
+
+            Type = upb_MiniTable_FindFieldByNumber(Table, 1);
+            Payload = upb_MiniTable_FindFieldByNumber(Table, 2);
+            Sequence = upb_MiniTable_FindFieldByNumber(Table, 3);
+            CreatedUnixMicros = upb_MiniTable_FindFieldByNumber(Table, 4);
+            SentUnixMicros = upb_MiniTable_FindFieldByNumber(Table, 5);
+            CorrelationId = upb_MiniTable_FindFieldByNumber(Table, 6);
+            IsResponse = upb_MiniTable_FindFieldByNumber(Table, 7);
+        }
+    };
+
+    const FEnvelopeMiniTable& GetEnvelopeMiniTable()
+    {
+        static const FEnvelopeMiniTable MiniTable;
+        return MiniTable;
+    }
+
+    // 别名字符串在Source中的子视图
+    bool SliceAliased(const FMessagePayloadView& Source, upb_StringView String, FMessagePayloadView& OutSlice)
+    {
+        if (String.size == 0)
+        {
+            OutSlice = Source.Slice(0, 0);
+            return true;
+        }
+
+        const intptr_t Offset = reinterpret_cast<const uint8*>(String.data) - Source.GetData();
+        if (Offset < 0 || Offset + (intptr_t)String.size > Source.Num())
+        {
+            return false;
+        }
+        OutSlice = Source.Slice((int32)Offset, (int32)String.size);
+        return true;
+    }
+}
+#endif
+
+FNetworkMessage FNetworkEnvelopeView::ToMessage() const
+{
+    FNetworkMessage Message(
+        UMessageMangerBPLibrary::ConvertUtf8BinaryToString(reinterpret_cast<const uint8*>(Type.GetData()), Type.Len()),
+        UMessageMangerBPLibrary::ConvertUtf8BinaryToString(Payload.GetData(), Payload.Num()));
+    Message.Sequence = Sequence;
+    Message.CreatedUnixMicros = CreatedUnixMicros;
+    Message.SentUnixMicros = SentUnixMicros;
+    Message.CorrelationId = CorrelationId;
+    Message.bIsResponse = bIsResponse;
+    return Message;
+}
+
+#if WITH_PROTOBUF
+
+bool FUpbEnvelopeDecoder::Decode(const FMessagePayloadView& Source, FNetworkEnvelopeView& OutEnvelope)
+{
+    const FEnvelopeMiniTable& MiniTable = GetEnvelopeMiniTable();
+    if (!MiniTable.Table)
+    {
+        return false;
+    }
+
+    // 临时arena建在栈上，信封只有几个标量字段，通常不需要再分配
+    alignas(16) char ArenaBlock[512];
+    upb_Arena* Arena = upb_Arena_Init(ArenaBlock, sizeof(ArenaBlock), &upb_alloc_global);
+    if (!Arena)
+    {
+        return false;
+    }
+
+    bool bDecoded = false;
+    upb_Message* Message = upb_Message_New(MiniTable.Table, Arena);
+    if (Message)
+    {
+        // AliasString：字符串字段直接指向Source的缓冲区，不复制到arena，arena释放后仍然有效
+        const upb_DecodeStatus Status = upb_Decode(reinterpret_cast<const char*>(Source.GetData()), Source.Num(),
+            Message, MiniTable.Table, nullptr, kUpb_DecodeOption_AliasString, Arena);
+        if (Status == kUpb_DecodeStatus_Ok)
+        {
+            const upb_StringView EmptyString = upb_StringView_FromDataAndSize(nullptr, 0);
+            const upb_StringView Type = upb_Message_GetString(Message, MiniTable.Type, EmptyString);
+            const upb_StringView Payload = upb_Message_GetString(Message, MiniTable.Payload, EmptyString);
+
+            FMessagePayloadView TypeSlice;
+            if (SliceAliased(Source, Type, TypeSlice) && SliceAliased(Source, Payload, OutEnvelope.Payload))
+            {
+                OutEnvelope.Source = Source;
+                OutEnvelope.Type = TypeSlice.GetUtf8View();
+                OutEnvelope.Sequence = (int64)upb_Message_GetUInt64(Message, MiniTable.Sequence, 0);
+                OutEnvelope.CreatedUnixMicros = upb_Message_GetInt64(Message, MiniTable.CreatedUnixMicros, 0);
+                OutEnvelope.SentUnixMicros = upb_Message_GetInt64(Message, MiniTable.SentUnixMicros, 0);
+                OutEnvelope.CorrelationId = (int64)upb_Message_GetUInt64(Message, MiniTable.CorrelationId, 0);
+                OutEnvelope.bIsResponse = upb_Message_GetBool(Message, MiniTable.IsResponse, false);
+                bDecoded = true;
+            }
+        }
+        else
+        {
+            UE_LOG(LogTemp, Error, TEXT("Failed to decode protobuf envelope with upb (%d bytes): %hs"), Source.Num(), upb_DecodeStatus_String(Status));
+        }
+    }
+
+    // 所有字段都已读出，arena中不再有被引用的数据
+    upb_Arena_Free(Arena);
+    return bDecoded;
+}
+
+#else
+
+bool FUpbEnvelopeDecoder::Decode(const FMessagePayloadView& Source, FNetworkEnvelopeView& OutEnvelope)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,273 @@
+﻿#include "Utf8Transcoder.h"
+
+#if WITH_UTF8_RANGE
+THIRD_PARTY_INCLUDES_START
+#include <utf8_range.h>
+THIRD_PARTY_INCLUDES_END
+#endif
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#define UTF8_TRANSCODER_SSE2 1
+#define UTF8_TRANSCODER_NEON 0
+#elif PLATFORM_CPU_ARM_FAMILY && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define UTF8_TRANSCODER_SSE2 0
+#define UTF8_TRANSCODER_NEON 1
+#else
+#define UTF8_TRANSCODER_SSE2 0
+#define UTF8_TRANSCODER_NEON 0
+#endif
+
+namespace
+{
+    constexpr uint32 ReplacementCharacter = 0xFFFD;
+
+    bool IsHighSurrogate(uint32 Unit) { return Unit >= 0xD800 && Unit <= 0xDBFF; }
+    bool IsLowSurrogate(uint32 Unit) { return Unit >= 0xDC00 && Unit <= 0xDFFF; }
+
+    // 16个UTF-16码元全部是ASCII时压缩为16字节写入Dest，否则返回false
+    FORCEINLINE bool TryNarrowAscii16(const UTF16CHAR* Source, uint8* Dest)
+    {
+#if UTF8_TRANSCODER_SSE2
+        const __m128i Low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source));
+        const __m128i High = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + 8));
+        const __m128i NonAscii = _mm_and_si128(_mm_or_si128(Low, High), _mm_set1_epi16((short)0xFF80));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(NonAscii, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest), _mm_packus_epi16(Low, High));
+        return true;
+#elif UTF8_TRANSCODER_NEON
+        const uint16x8_t Low = vld1q_u16(reinterpret_cast<const uint16*>(Source));
+        const uint16x8_t High = vld1q_u16(reinterpret_cast<const uint16*>(Source + 8));
+        if (vmaxvq_u16(vorrq_u16(Low, High)) >= 0x80)
+        {
+            return false;
+        }
+        vst1q_u8(Dest, vcombine_u8(vmovn_u16(Low), vmovn_u16(High)));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // 16个UTF-8字节全部是ASCII时扩展为16个码元写入Dest，否则返回false
+    FORCEINLINE bool TryWidenAscii16(const uint8* Source, UTF16CHAR* Dest)
+    {
+#if UTF8_TRANSCODER_SSE2
+        const __m128i Bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source));
+        if (_mm_movemask_epi8(Bytes) != 0)
+        {
+            return false;
+        }
+        const __m128i Zero = _mm_setzero_si128();
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest), _mm_unpacklo_epi8(Bytes, Zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest + 8), _mm_unpackhi_epi8(Bytes, Zero));
+        return true;
+#elif UTF8_TRANSCODER_NEON
+        const uint8x16_t Bytes = vld1q_u8(Source);
+        if (vmaxvq_u8(Bytes) >= 0x80)
+        {
+            return false;
+        }
+        vst1q_u16(reinterpret_cast<uint16*>(Dest), vmovl_u8(vget_low_u8(Bytes)));
+        vst1q_u16(reinterpret_cast<uint16*>(Dest + 8), vmovl_u8(vget_high_u8(Bytes)));
+        return true;
+#else
+        return false;
+#endif
+    }
+}
+
+int32 FUtf8Transcoder::EncodeCodePoint(uint32 CodePoint, uint8* Dest)
+{
+    if (CodePoint < 0x80)
+    {
+        Dest[0] = (uint8)CodePoint;
+        return 1;
+    }
+    if (CodePoint < 0x800)
+    {
+        Dest[0] = (uint8)(0xC0 | (CodePoint >> 6));
+        Dest[1] = (uint8)(0x80 | (CodePoint & 0x3F));
+        return 2;
+    }
+    if (CodePoint > 0x10FFFF || (CodePoint >= 0xD800 && CodePoint <= 0xDFFF))
+    {
+        CodePoint = ReplacementCharacter;
+    }
+    if (CodePoint < 0x10000)
+    {
+        Dest[0] = (uint8)(0xE0 | (CodePoint >> 12));
+        Dest[1] = (uint8)(0x80 | ((CodePoint >> 6) & 0x3F));
+        Dest[2] = (uint8)(0x80 | (CodePoint & 0x3F));
+        return 3;
+    }
+    Dest[0] = (uint8)(0xF0 | (CodePoint >> 18));
+    Dest[1] = (uint8)(0x80 | ((CodePoint >> 12) & 0x3F));
+    Dest[2] = (uint8)(0x80 | ((CodePoint >> 6) & 0x3F));
+    Dest[3] = (uint8)(0x80 | (CodePoint & 0x3F));
+    return 4;
+}
+
+int32 FUtf8Transcoder::Utf16ToUtf8(const UTF16CHAR* Source, int32 Length, uint8* Dest)
+{
+    uint8* Out = Dest;
+    int32 Index = 0;
+    while (Index < Length)
+    {
+        // ASCII快速路径
+        if (Index + 16 <= Length && TryNarrowAscii16(Source + Index, Out))
+        {
+            Index += 16;
+            Out += 16;
+            continue;
+        }
+
+        // 逐个码点转换，直到下一个16字符块
+        const int32 BlockEnd = FMath::Min(Length, Index + 16);
+        while (Index < BlockEnd)
+        {
+            uint32 CodePoint = Source[Index++];
+            if (CodePoint < 0x80)
+            {
+                *Out++ = (uint8)CodePoint;
+                continue;
+            }
+            if (IsHighSurrogate(CodePoint))
+            {
+                if (Index < Length && IsLowSurrogate(Source[Index]))
+                {
+                    CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + ((uint32)Source[Index++] - 0xDC00);
+                }
+                else
+                {
+                    CodePoint = ReplacementCharacter;
+                }
+            }
+            else if (IsLowSurrogate(CodePoint))
+            {
+                CodePoint = ReplacementCharacter;
+            }
+            Out += EncodeCodePoint(CodePoint, Out);
+        }
+    }
+    return (int32)(Out - Dest);
+}
+
+int32 FUtf8Transcoder::Utf8ToUtf16(const uint8* Source, int32 Length, UTF16CHAR* Dest)
+{
+    UTF16CHAR* Out = Dest;
+    int32 Index = 0;
+    while (Index < Length)
+    {
+        // ASCII快速路径
+        if (Index + 16 <= Length && TryWidenAscii16(Source + Index, Out))
+        {
+            Index += 16;
+            Out += 16;
+            continue;
+        }
+
+        // 逐个码点转换，直到下一个16字节块（输入已验证，多字节序列不会越界）
+        const int32 BlockEnd = FMath::Min(Length, Index + 16);
+        while (Index < BlockEnd)
+        {
+            const uint32 Lead = Source[Index];
+            if (Lead < 0x80)
+            {
+                *Out++ = (UTF16CHAR)Lead;
+                Index += 1;
+            }
+            else if (Lead < 0xE0)
+            {
+                *Out++ = (UTF16CHAR)(((Lead & 0x1F) << 6) | (Source[Index + 1] & 0x3F));
+                Index += 2;
+            }
+            else if (Lead < 0xF0)
+            {
+                *Out++ = (UTF16CHAR)(((Lead & 0x0F) << 12) | ((Source[Index + 1] & 0x3F) << 6) | (Source[Index + 2] & 0x3F));
+                Index += 3;
+            }
+            else
+            {
+                const uint32 CodePoint = ((Lead & 0x07) << 18) | ((Source[Index + 1] & 0x3F) << 12)
+                    | ((Source[Index + 2] & 0x3F) << 6) | (Source[Index + 3] & 0x3F);
+                *Out++ = (UTF16CHAR)(0xD800 + ((CodePoint - 0x10000) >> 10));
+                *Out++ = (UTF16CHAR)(0xDC00 + ((CodePoint - 0x10000) & 0x3FF));
+                Index += 4;
+            }
+        }
+    }
+    return (int32)(Out - Dest);
+}
+
+bool FUtf8Transcoder::IsValidUtf8(const uint8* Data, int32 Length)
+{
+    if (Length <= 0)
+    {
+        return true;
+    }
+#if WITH_UTF8_RANGE
+    return utf8_range_IsValid(reinterpret_cast<const char*>(Data), (size_t)Length) != 0;
+#else
+    // 没有utf8_range的平台：逐字符验证，ASCII部分每次检查8字节
+    int32 Index = 0;
+    while (Index < Length)
+    {
+        if (Index + 8 <= Length && (FPlatformMemory::ReadUnaligned<uint64>(Data + Index) & 0x8080808080808080ull) == 0)
+        {
+            Index += 8;
+            continue;
+        }
+
+        const uint8 Lead = Data[Index];
+        if (Lead < 0x80)
+        {
+            ++Index;
+            continue;
+        }
+
+        // 按首字节确定长度和第二字节的范围，排除过长编码、代理区和超过U+10FFFF的码点
+        int32 SequenceLength;
+        uint8 SecondMin = 0x80;
+        uint8 SecondMax = 0xBF;
+        if (Lead >= 0xC2 && Lead <= 0xDF)
+        {
+            SequenceLength = 2;
+        }
+        else if (Lead >= 0xE0 && Lead <= 0xEF)
+        {
+            SequenceLength = 3;
+            SecondMin = Lead == 0xE0 ? 0xA0 : 0x80;
+            SecondMax = Lead == 0xED ? 0x9F : 0xBF;
+        }
+        else if (Lead >= 0xF0 && Lead <= 0xF4)
+        {
+            SequenceLength = 4;
+            SecondMin = Lead == 0xF0 ? 0x90 : 0x80;
+            SecondMax = Lead == 0xF4 ? 0x8F : 0xBF;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (Index + SequenceLength > Length || Data[Index + 1] < SecondMin || Data[Index + 1] > SecondMax)
+        {
+            return false;
+        }
+        for (int32 Offset = 2; Offset < SequenceLength; ++Offset)
+        {
+            if ((Data[Index + Offset] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+        Index += SequenceLength;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "MessageInbox.h"
+#include <atomic>
+
+// 保序的并行解码流水线
+// 接收线程按到达顺序为每条消息分配序号，需要解码的消息交给UE::Tasks工作线程，
+// 解码结果在重排缓冲区中按序号排好后再放入收件箱，同一连接上的消息顺序不变
+class MESSAGEMANGER_API FOrderedDecodePipeline
+{
+public:
+    // 在工作线程上解码一条消息，结果写入Entry.Decoded
+    using FDecodeFunction = TFunction<void(FInboxEntry& Entry)>;
+
+    explicit FOrderedDecodePipeline(FMessageInbox& InInbox);
+    ~FOrderedDecodePipeline();
+
+    // 设置解码函数，在没有消息提交时调用
+    void SetDecodeFunction(FDecodeFunction InDecodeFunction) { DecodeFunction = MoveTemp(InDecodeFunction); }
+
+    // 提交一条消息（只能在接收线程调用），bDecodeInParallel为false时不解码，只占一个序号
+    void Submit(FInboxEntry&& Entry, bool bDecodeInParallel);
+
+    // 等待所有解码任务完成，结果都已放入收件箱后返回（接收线程停止后调用）
+    void Flush();
+
+    // 正在解码和等待重排的消息数
+    int32 NumInFlight() const { return InFlight.load(std::memory_order_relaxed); }
+
+private:
+    // 记录一条完成的消息，并把从下一个待交付序号开始连续完成的消息放入收件箱
+    void Complete(uint64 Sequence, FInboxEntry&& Entry);
+
+    FMessageInbox& Inbox;
+    FDecodeFunction DecodeFunction;
+
+    // 下一个分配的序号（只在接收线程访问）
+    uint64 NextSequence;
+
+    // 重排缓冲区，收件箱的入队也在锁内进行，保证收件箱只有一个生产者
+    FCriticalSection ReorderLock;
+    uint64 NextToDeliver;
+    TMap<uint64, FInboxEntry> Pending;
+
+    std::atomic<int32> InFlight;
+};
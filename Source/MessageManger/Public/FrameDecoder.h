@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MessageProtocol.h"
+
+class FSocket;
+
+// 基于固定大小环形缓冲区的增量分片解码器
+// 一次读取尽可能多的内核数据，原地切出所有完整分片，不完整的字节保留到下次读取
+class MESSAGEMANGER_API FFrameDecoder
+{
+public:
+    // 读取结果
+    enum class EReadResult : uint8
+    {
+        // 已读完内核中的数据
+        Drained,
+        // 环形缓冲区已满，需要先提取分片再继续读取
+        BufferFull,
+        // 对端关闭或接收出错
+        Closed,
+    };
+
+    // 容量会向上取整为2的幂，且至少能容纳一个最大分片
+    // InMaxMessageSize: 头部中总长度的上限，超过时视为非法头部，接收端不会按对端声明的长度分配内存
+    explicit FFrameDecoder(int32 InCapacity = 256 * 1024, int32 InMaxMessageSize = MAX_int32);
+
+    // 从Socket读取数据到环形缓冲区，直到内核无数据或缓冲区已满
+    EReadResult ReadFromSocket(FSocket& Socket, int32& OutBytesRead);
+
+    // 提取所有完整分片，Payload指针只在回调期间有效
+    // 返回false表示遇到非法头部（包括总长度超过上限），字节流已无法继续解析
+    bool ExtractFrames(TFunctionRef<void(const FChunkHeader& Header, const uint8* Payload, int32 PayloadSize)> FrameCallback);
+
+    // 当前缓冲的未解析字节数
+    int32 GetBufferedBytes() const { return (int32)(WritePos - ReadPos); }
+
+    // 开启内核接收时间戳（Linux SO_TIMESTAMPNS），平台不支持时返回false
+    static bool EnableArrivalTimestamps(FSocket& Socket);
+
+    // 内核队列中最早的未读数据从到达到现在经过的纳秒数，不取出数据
+    // 在Wait返回后立即调用即为唤醒延迟；没有时间戳或没有数据时返回false
+    static bool PeekArrivalAge(FSocket& Socket, int64& OutAgeNanos);
+
+private:
+    // 从逻辑位置复制数据（处理环绕）
+    void CopyOut(uint64 Position, uint8* Dest, int32 Size) const;
+
+    // 环形缓冲区
+    TArray<uint8> Ring;
+
+    // 跨越缓冲区末尾的分片线性化后的临时区
+    TArray<uint8> Scratch;
+
+    // 容量掩码
+    uint64 Mask;
+
+    // 头部中总长度的上限
+    uint32 MaxMessageSize;
+
+    // 单调递增的读写位置
+    uint64 ReadPos;
+    uint64 WritePos;
+};
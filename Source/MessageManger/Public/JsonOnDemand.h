@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class FJsonOnDemandDocument;
+
+// 按需解析的JSON值类型
+enum class EJsonOnDemandType : uint8
+{
+    Invalid,
+    Object,
+    Array,
+    String,
+    Number,
+    Boolean,
+    Null,
+};
+
+// 文档中的一个值，访问时才解析，只在文档和源字节有效期间可用
+// 字符串、数字等的格式错误在访问时报告（返回false或无效值）
+class MESSAGEMANGER_API FJsonOnDemandValue
+{
+public:
+    FJsonOnDemandValue() = default;
+
+    bool IsValid() const { return Document != nullptr; }
+    EJsonOnDemandType GetType() const;
+
+    // 按键查找对象字段，键按转义前的原始字节比较；不是对象或找不到时返回无效值
+    FJsonOnDemandValue FindField(FUtf8StringView Key) const;
+
+    // 依次访问对象的字段（键为转义前的原始字节），Visitor返回false时停止；格式错误时返回false
+    bool ForEachField(TFunctionRef<bool(FUtf8StringView Key, const FJsonOnDemandValue& Value)> Visitor) const;
+
+    // 依次访问数组元素，Visitor返回false时停止；格式错误时返回false
+    bool ForEachElement(TFunctionRef<bool(const FJsonOnDemandValue& Element)> Visitor) const;
+
+    // 读取字符串并处理转义
+    bool GetString(FString& OutString) const;
+
+    // 引号之间的原始UTF-8字节（未处理转义），直接引用源字节
+    bool GetRawString(FUtf8StringView& OutString) const;
+
+    // 读取字符串并处理转义，结果为UTF-8：没有转义时直接引用源字节，否则写入Scratch并引用Scratch
+    bool GetUtf8String(TArray<uint8>& Scratch, FUtf8StringView& OutString) const;
+
+    bool GetDouble(double& OutValue) const;
+    bool GetInt64(int64& OutValue) const;
+    bool GetBool(bool& OutValue) const;
+    bool IsNull() const;
+
+    // 值的完整JSON文本，直接引用源字节
+    FUtf8StringView GetRawJson() const;
+
+    // 值在源字节中的偏移，配合GetRawJson().Len()可以在接收缓冲区上切出子视图
+    int32 GetOffset() const { return Start; }
+
+private:
+    friend class FJsonOnDemandDocument;
+
+    FJsonOnDemandValue(const FJsonOnDemandDocument* InDocument, int32 InStart, int32 InToken)
+        : Document(InDocument), Start(InStart), Token(InToken)
+    {
+    }
+
+    // 标量的文本（去掉尾部空白）
+    FUtf8StringView GetScalarText() const;
+
+    // 值之后的第一个结构字符在索引中的位置
+    int32 GetEndToken() const;
+
+    const FJsonOnDemandDocument* Document = nullptr;
+
+    // 值第一个字符的字节偏移
+    int32 Start = 0;
+
+    // 字节偏移不小于Start的第一个结构字符在索引中的位置
+    int32 Token = 0;
+};
+
+// simdjson式的两阶段JSON解析
+// 第一阶段每次处理64字节，用SIMD（x86为SSE2，ARM64为NEON）找出引号、反斜杠和结构字符，
+// 用前缀异或算出字符串内的范围，把字符串外的结构字符和所有未转义的引号写入索引，并匹配括号；
+// 第二阶段按索引跳转，只解析实际访问的值，跳过不关心的对象和数组是O(1)
+// 文档可以反复Parse复用内部数组，稳态下没有堆分配；非线程安全
+class MESSAGEMANGER_API FJsonOnDemandDocument
+{
+public:
+    // 为InData建立结构索引并验证UTF-8和括号匹配，InData在使用文档期间必须保持有效
+    bool Parse(const uint8* InData, int32 InLength);
+
+    // 根值，Parse失败时返回无效值
+    FJsonOnDemandValue GetRoot() const;
+
+    // 索引中的结构字符数
+    int32 GetStructuralCount() const { return FMath::Max(0, Structurals.Num() - 1); }
+
+private:
+    friend class FJsonOnDemandValue;
+
+    // 建立结构索引，字符串未闭合或含未转义的控制字符时返回false
+    bool BuildStructuralIndex();
+
+    // 匹配括号，写入Matching
+    bool MatchBrackets();
+
+    // 从字节偏移After开始跳过空白，构造索引位置为InToken的值
+    FJsonOnDemandValue MakeValue(int32 After, int32 InToken) const;
+
+    // 索引位置上的字符，超出范围时返回0
+    uint8 TokenChar(int32 InToken) const
+    {
+        return InToken < Structurals.Num() - 1 ? Data[Structurals[InToken]] : 0;
+    }
+
+    const uint8* Data = nullptr;
+    int32 Length = 0;
+    bool bValid = false;
+
+    // 结构字符的字节偏移，最后一项为Length（哨兵）
+    TArray<uint32> Structurals;
+
+    // 左括号在索引中的位置 -> 匹配的右括号在索引中的位置
+    TArray<int32> Matching;
+
+    // 括号匹配用的栈
+    TArray<int32> OpenStack;
+
+    // 处理转义用的暂存区
+    mutable TArray<uint8> UnescapeScratch;
+};
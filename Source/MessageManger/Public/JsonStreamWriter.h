@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// 流式JSON写入器，直接把UTF-8追加到输出数组
+// 不构造FJsonObject/FJsonValue，也不生成中间的TCHAR字符串；输出数组复用时稳态下没有堆分配
+// 只生成紧凑格式（无空白），字符串转义规则与TCondensedJsonPrintPolicy一致
+class MESSAGEMANGER_API FJsonStreamWriter
+{
+public:
+    explicit FJsonStreamWriter(TArray<uint8>& InOutput)
+        : Output(InOutput)
+    {
+    }
+
+    void BeginObject();
+    void EndObject();
+
+    // 写入字符串字段，Key必须是不需要转义的ASCII
+    void WriteStringField(FAnsiStringView Key, FStringView Value);
+
+    // 写入无符号整数字段
+    void WriteUInt64Field(FAnsiStringView Key, uint64 Value);
+
+    // 写入布尔字段
+    void WriteBoolField(FAnsiStringView Key, bool bValue);
+
+    // 将RawJson作为JSON值原样写入字段，RawJson不是单个合法的JSON值时不写入并返回false
+    bool WriteRawField(FAnsiStringView Key, FStringView RawJson);
+
+    // 将字符串转义为带引号的JSON字符串，以UTF-8追加到Output
+    // 不需要转义的ASCII段每次处理16个字符（x86用SSE2，ARM64用NEON）
+    static void AppendEscapedString(FStringView Value, TArray<uint8>& Output);
+
+private:
+    void WriteKey(FAnsiStringView Key);
+
+    TArray<uint8>& Output;
+
+    // 当前对象中是否已经写过字段
+    bool bNeedsComma = false;
+};
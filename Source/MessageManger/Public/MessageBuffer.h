@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// 引用计数的消息缓冲区，接收线程写入一次后只读共享
+using FMessageBufferRef = TSharedRef<TArray<uint8>, ESPMode::ThreadSafe>;
+
+// 消息缓冲区中一段字节的只读视图
+// 持有缓冲区引用，可以安全地跨线程传递而不复制数据
+struct FMessagePayloadView
+{
+    FMessagePayloadView() = default;
+
+    explicit FMessagePayloadView(const FMessageBufferRef& InBuffer)
+        : Buffer(InBuffer), Offset(0), Length(InBuffer->Num()) {}
+
+    FMessagePayloadView(const FMessageBufferRef& InBuffer, int32 InOffset, int32 InLength)
+        : Buffer(InBuffer), Offset(InOffset), Length(InLength)
+    {
+        check(InOffset >= 0 && InLength >= 0 && InOffset + InLength <= InBuffer->Num());
+    }
+
+    // 分配一个可容纳Size字节的新缓冲区
+    static FMessageBufferRef AllocateBuffer(int32 Size)
+    {
+        FMessageBufferRef NewBuffer = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+        NewBuffer->SetNumUninitialized(Size);
+        return NewBuffer;
+    }
+
+    bool IsValid() const { return Buffer.IsValid(); }
+    const uint8* GetData() const { return Buffer.IsValid() ? Buffer->GetData() + Offset : nullptr; }
+    int32 Num() const { return Length; }
+
+    TArrayView<const uint8> GetView() const { return TArrayView<const uint8>(GetData(), Length); }
+    FUtf8StringView GetUtf8View() const { return FUtf8StringView(reinterpret_cast<const UTF8CHAR*>(GetData()), Length); }
+
+    // 同一缓冲区上的子视图
+    FMessagePayloadView Slice(int32 InOffset, int32 InLength) const
+    {
+        check(InOffset >= 0 && InLength >= 0 && InOffset + InLength <= Length);
+        FMessagePayloadView Result;
+        Result.Buffer = Buffer;
+        Result.Offset = Offset + InOffset;
+        Result.Length = InLength;
+        return Result;
+    }
+
+private:
+    TSharedPtr<const TArray<uint8>, ESPMode::ThreadSafe> Buffer;
+    int32 Offset = 0;
+    int32 Length = 0;
+};
+
+// 单个线程复用的消息缓冲区池
+// 交出去的缓冲区由引用计数持有，其他引用（写入器、零拷贝发送）都释放后，下次Acquire时清空复用，保留已分配的容量
+class FMessageBufferPool
+{
+public:
+    explicit FMessageBufferPool(int32 InMaxBuffers = 64, int32 InMaxRetainedBytes = 1024 * 1024)
+        : MaxBuffers(InMaxBuffers), MaxRetainedBytes(InMaxRetainedBytes)
+    {
+    }
+
+    // 取一个空缓冲区，池中没有空闲缓冲区时新分配
+    FMessageBufferRef Acquire()
+    {
+        for (int32 Scanned = 0; Scanned < Buffers.Num(); ++Scanned)
+        {
+            NextIndex = (NextIndex + 1) % Buffers.Num();
+            FMessageBufferRef& Buffer = Buffers[NextIndex];
+            if (Buffer.GetSharedReferenceCount() == 1)
+            {
+                // 偶尔出现的超大消息不长期占用内存
+                if (Buffer->Max() > MaxRetainedBytes)
+                {
+                    Buffer->Empty();
+                }
+                else
+                {
+                    Buffer->Reset();
+                }
+                return Buffer;
+            }
+        }
+
+        FMessageBufferRef NewBuffer = MakeShared<TArray<uint8>, ESPMode::ThreadSafe>();
+        if (Buffers.Num() < MaxBuffers)
+        {
+            Buffers.Add(NewBuffer);
+        }
+        return NewBuffer;
+    }
+
+private:
+    TArray<FMessageBufferRef> Buffers;
+    int32 NextIndex = 0;
+    int32 MaxBuffers;
+    int32 MaxRetainedBytes;
+};
@@ -0,0 +1,165 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "JsonObjectConverter.h"
+#include "TCPCommunicationSubsystem.h"
+#include <atomic>
+#include <coroutine>
+
+// 协程帧的池化分配器
+// 按64字节分级，每级一个无锁空闲链表，释放的帧留给下一个同级的协程复用；超过2KB的帧直接使用FMemory
+class MESSAGEMANGER_API FCoroutineFramePool
+{
+public:
+    static void* Allocate(SIZE_T Size);
+    static void Free(void* Frame, SIZE_T Size);
+};
+
+// 消息协程的返回类型：调用后立即开始执行，执行完自动释放协程帧
+// 例：
+//     FNetworkCoroutine Login(FMessageChannel& Channel)
+//     {
+//         FRpcResult Result = co_await Channel.Call(FNetworkMessage(TEXT("Login"), Credentials));
+//         TOptional<FNetworkMessage> Ready = co_await Channel.Receive(TEXT("WorldReady"));
+//     }
+struct FNetworkCoroutine
+{
+    struct promise_type
+    {
+        FNetworkCoroutine get_return_object() { return FNetworkCoroutine(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { checkNoEntry(); }
+
+        static void* operator new(std::size_t Size) { return FCoroutineFramePool::Allocate(Size); }
+        static void operator delete(void* Frame, std::size_t Size) { FCoroutineFramePool::Free(Frame, Size); }
+    };
+};
+
+// 在游戏线程上等待消息和RPC响应的协程接口
+// 协程在收件箱分发消息的Tick中直接恢复，不经过额外的TaskGraph任务；等待时只使用协程帧中的awaiter，
+// 每种消息类型只在第一次等待时订阅一次。只能在游戏线程上co_await
+class MESSAGEMANGER_API FMessageChannel
+{
+public:
+    explicit FMessageChannel(UTCPCommunicationSubsystem& InSubsystem);
+
+    // 析构时以空结果恢复所有正在等待的协程
+    ~FMessageChannel();
+
+    FMessageChannel(const FMessageChannel&) = delete;
+    FMessageChannel& operator=(const FMessageChannel&) = delete;
+
+    // 等待下一条指定类型的消息，通道关闭时结果为空
+    class FReceiveAwaiter
+    {
+    public:
+        FReceiveAwaiter(FMessageChannel& InChannel, const FString& InType)
+            : Channel(InChannel)
+            , Type(InType)
+        {
+        }
+
+        bool await_ready() const { return Channel.bClosed; }
+        void await_suspend(std::coroutine_handle<> Handle);
+        TOptional<FNetworkMessage> await_resume() { return MoveTemp(Result); }
+
+    protected:
+        friend class FMessageChannel;
+
+        FMessageChannel& Channel;
+        FString Type;
+        std::coroutine_handle<> Continuation;
+        FReceiveAwaiter* Next = nullptr;
+        TOptional<FNetworkMessage> Result;
+    };
+
+    // 等待下一条指定类型的消息并把JsonData转换为USTRUCT，通道关闭或转换失败时结果为空
+    template<typename T>
+    class TReceiveAwaiter : public FReceiveAwaiter
+    {
+    public:
+        using FReceiveAwaiter::FReceiveAwaiter;
+
+        TOptional<T> await_resume()
+        {
+            TOptional<T> Value;
+            if (Result.IsSet() && !FJsonObjectConverter::JsonObjectStringToUStruct(Result->JsonData, &Value.Emplace()))
+            {
+                Value.Reset();
+            }
+            return Value;
+        }
+    };
+
+    // 等待RPC响应
+    class FCallAwaiter : public FRpcWaiter
+    {
+    public:
+        FCallAwaiter(FMessageChannel& InChannel, const FNetworkMessage& InRequest, float InTimeoutSeconds, const FString& InResponseType)
+            : Channel(InChannel)
+            , Request(InRequest)
+            , TimeoutSeconds(InTimeoutSeconds)
+            , ResponseType(InResponseType)
+        {
+        }
+
+        bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> Handle);
+        FRpcResult await_resume() { return MoveTemp(Result); }
+
+        virtual void OnRpcComplete(FRpcResult&& InResult) override;
+
+    private:
+        FMessageChannel& Channel;
+        FNetworkMessage Request;
+        float TimeoutSeconds;
+        FString ResponseType;
+
+        std::coroutine_handle<> Continuation;
+        FRpcResult Result;
+
+        // 挂起和完成谁后到达谁负责继续执行，调用在CallRemote内立即完成时不挂起
+        std::atomic<bool> bHandoff{ false };
+    };
+
+    // co_await Channel.Receive(TEXT("Type"))
+    FReceiveAwaiter Receive(const FString& Type) { return FReceiveAwaiter(*this, Type); }
+
+    // co_await Channel.Receive<FMyStruct>(TEXT("Type"))
+    template<typename T>
+    TReceiveAwaiter<T> Receive(const FString& Type) { return TReceiveAwaiter<T>(*this, Type); }
+
+    // co_await Channel.Receive<FMyStruct>()，消息类型为结构体名（不带F前缀）
+    template<typename T>
+    TReceiveAwaiter<T> Receive() { return TReceiveAwaiter<T>(*this, T::StaticStruct()->GetName()); }
+
+    // co_await Channel.Call(Request)，参数含义与UTCPCommunicationSubsystem::CallRemote相同
+    FCallAwaiter Call(const FNetworkMessage& Request, float TimeoutSeconds = 0.0f, const FString& ResponseType = FString())
+    {
+        return FCallAwaiter(*this, Request, TimeoutSeconds, ResponseType);
+    }
+
+    // 取消订阅并以空结果恢复所有正在等待消息的协程，之后的Receive立即返回空结果
+    void Close();
+
+private:
+    // 同一类型的等待者链表（按等待顺序）
+    struct FTypeWaiters
+    {
+        FDelegateHandle Subscription;
+        FReceiveAwaiter* Head = nullptr;
+        FReceiveAwaiter* Tail = nullptr;
+    };
+
+    void AddWaiter(FReceiveAwaiter& Awaiter);
+    void HandleMessage(const FNetworkMessage& Message, uint16 TypeId);
+
+    // 恢复链表中的所有等待者，Message为空表示通道关闭
+    static void ResumeWaiters(FReceiveAwaiter* Head, const FNetworkMessage* Message);
+
+    TWeakObjectPtr<UTCPCommunicationSubsystem> Subsystem;
+    TMap<uint16, FTypeWaiters> Waiters;
+    bool bClosed = false;
+};
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/SpscQueue.h"
+#include "JsonOnDemand.h"
+#include "MessageBuffer.h"
+#include "NetworkMessage.h"
+#include "UpbEnvelopeDecoder.h"
+#include <atomic>
+
+// 在工作线程上预先解码的结果（并行解码时）
+struct FDecodedPayload
+{
+    // JSON编码：已建立结构索引的文档
+    FJsonOnDemandDocument Document;
+
+    // 文档解析或protobuf解码是否成功
+    bool bParsed = false;
+
+    // 已转换的消息，只在有人需要FNetworkMessage时转换
+    FNetworkMessage Message;
+    bool bHasMessage = false;
+};
+
+// 收件箱中的一条消息：原始负载，或upb解码后的信封
+struct FInboxEntry
+{
+    // 原始负载（Envelope未设置时有效）
+    FMessagePayloadView Payload;
+
+    // 分片头部或批量帧前缀中的类型ID
+    uint16 TypeId = 0;
+
+    // upb解码模式下的信封，字段引用接收缓冲区
+    TOptional<FNetworkEnvelopeView> Envelope;
+
+    // 并行解码的结果，为空时由游戏线程解码
+    TSharedPtr<const FDecodedPayload, ESPMode::ThreadSafe> Decoded;
+
+    // 按(TypeId, CoalesceKey)合并：同一个键只保留最新一条等待分发的消息
+    bool bCoalesce = false;
+    uint64 CoalesceKey = 0;
+};
+
+// 接收线程到游戏线程的单生产者单消费者无锁收件箱
+// 接收线程入队，游戏线程每帧在时间预算内出队，超出预算的消息留到下一帧
+// 合并的消息在队列中只有一个占位条目，实际内容存放在合并表中，同一个键的新消息原地替换旧消息，
+// 游戏线程卡顿时每个键只分发一次最新值
+class MESSAGEMANGER_API FMessageInbox
+{
+public:
+    FMessageInbox() : Depth(0), CoalescedCount(0) {}
+
+    // 入队（只能在生产者线程调用）
+    // Entry.bCoalesce为true且该键已有等待分发的消息时，只替换那条消息，队列深度不变
+    void Enqueue(FInboxEntry&& Entry);
+
+    // 出队并处理消息，直到队列为空或用完BudgetCycles（0表示不限），返回处理的消息数
+    // 至少处理一条消息，保证预算很小时队列也能前进（只能在消费者线程调用）
+    int32 Drain(uint64 BudgetCycles, TFunctionRef<void(FInboxEntry&)> Handler);
+
+    // 丢弃所有消息（只能在消费者线程调用，且生产者已停止）
+    void Empty();
+
+    // 当前队列深度（任意线程）
+    int32 Num() const { return Depth.load(std::memory_order_relaxed); }
+
+    // 被更新的消息替换掉、没有分发的消息总数（任意线程）
+    uint64 GetCoalescedCount() const { return CoalescedCount.load(std::memory_order_relaxed); }
+
+private:
+    TSpscQueue<FInboxEntry> Queue;
+    std::atomic<int32> Depth;
+
+    // 等待分发的合并消息，键为(TypeId, CoalesceKey)，分发后移除
+    FCriticalSection CoalesceLock;
+    TMap<TPair<uint16, uint64>, FInboxEntry> CoalescedEntries;
+    std::atomic<uint64> CoalescedCount;
+};
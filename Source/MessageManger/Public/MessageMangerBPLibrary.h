@@ -35,9 +35,16 @@ class UMessageMangerBPLibrary : public UBlueprintFunctionLibrary
     UFUNCTION(BlueprintCallable)
 	static FString ConvertUtf8BinaryToString(const TArray<uint8>& BinaryData);
 
-	// 将 const wchar_t* 转换为二进制字节数组
+	// 将指定长度的 UTF-8 字节转为 FString（不要求以 '\0' 结尾，不复制源数据）
+	static FString ConvertUtf8BinaryToString(const uint8* Data, int32 Length);
+
+	// 将 const wchar_t* 转换为 UTF-8 字节数组（不含结尾的 '\0'）
 	static void ConvertWCharToBinary(const wchar_t* WideStr, TArray<uint8>& OutBinaryData);
 
+	// 将 FString 转换为 UTF-8 字节数组（不含结尾的 '\0'）
 	UFUNCTION(BlueprintCallable)
 	static void ConvertFStringToBinary(FString Str, TArray<uint8>& outBinaryData);
+
+	// 将指定长度的字符追加为 UTF-8 字节（不要求以 '\0' 结尾）
+	static void AppendStringAsUtf8(const TCHAR* Data, int32 Length, TArray<uint8>& OutBinaryData);
 };
@@ -0,0 +1,145 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include <atomic>
+
+// stat MessageManger
+DECLARE_STATS_GROUP(TEXT("MessageManger"), STATGROUP_MessageManger, STATCAT_Advanced);
+
+// 游戏线程收件箱中等待分发的消息数
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Inbox Depth"), STAT_MessageMangerInboxDepth, STATGROUP_MessageManger, MESSAGEMANGER_API);
+
+// 延迟统计快照（单位：微秒）
+struct FLatencySnapshot
+{
+    uint64 SampleCount = 0;
+    double P50Micros = 0.0;
+    double P99Micros = 0.0;
+    double MaxMicros = 0.0;
+
+    FString ToString() const
+    {
+        return FString::Printf(TEXT("samples=%llu p50=%.1fus p99=%.1fus max=%.1fus"), SampleCount, P50Micros, P99Micros, MaxMicros);
+    }
+};
+
+// 吞吐量统计快照
+struct FThroughputSnapshot
+{
+    uint64 Messages = 0;
+    uint64 Bytes = 0;
+    uint64 WriteCalls = 0;
+    double ElapsedSeconds = 0.0;
+
+    double MessagesPerSecond() const { return ElapsedSeconds > 0.0 ? Messages / ElapsedSeconds : 0.0; }
+    double MegabytesPerSecond() const { return ElapsedSeconds > 0.0 ? Bytes / ElapsedSeconds / (1024.0 * 1024.0) : 0.0; }
+    double MessagesPerWrite() const { return WriteCalls > 0 ? (double)Messages / WriteCalls : 0.0; }
+
+    FString ToString() const
+    {
+        return FString::Printf(TEXT("msgs=%llu (%.0f/s) bytes=%llu (%.2f MB/s) writes=%llu (%.1f msgs/write)"),
+            Messages, MessagesPerSecond(), Bytes, MegabytesPerSecond(), WriteCalls, MessagesPerWrite());
+    }
+};
+
+// 编解码开销快照
+struct FCodecSnapshot
+{
+    uint64 Messages = 0;
+    uint64 Bytes = 0;
+    double CpuSeconds = 0.0;
+
+    double NanosPerMessage() const { return Messages > 0 ? CpuSeconds * 1.0e9 / Messages : 0.0; }
+    double BytesPerMessage() const { return Messages > 0 ? (double)Bytes / Messages : 0.0; }
+
+    FString ToString() const
+    {
+        return FString::Printf(TEXT("msgs=%llu bytes/msg=%.1f cpu/msg=%.0fns"), Messages, BytesPerMessage(), NanosPerMessage());
+    }
+};
+
+// 无锁编解码开销计数器（消息数、编码后字节数、CPU周期）
+class MESSAGEMANGER_API FCodecCounter
+{
+public:
+    FCodecCounter() { Reset(); }
+
+    void AddMessage(uint64 InBytes, uint64 InCycles)
+    {
+        AddMessages(1, InBytes, InCycles);
+    }
+
+    void AddMessages(uint64 InMessages, uint64 InBytes, uint64 InCycles)
+    {
+        Messages.fetch_add(InMessages, std::memory_order_relaxed);
+        Bytes.fetch_add(InBytes, std::memory_order_relaxed);
+        Cycles.fetch_add(InCycles, std::memory_order_relaxed);
+    }
+
+    FCodecSnapshot Snapshot() const;
+
+    void Reset();
+
+private:
+    std::atomic<uint64> Messages;
+    std::atomic<uint64> Bytes;
+    std::atomic<uint64> Cycles;
+};
+
+// 无锁吞吐量计数器
+class MESSAGEMANGER_API FThroughputCounter
+{
+public:
+    FThroughputCounter() { Reset(); }
+
+    void AddMessage(uint64 InBytes)
+    {
+        Messages.fetch_add(1, std::memory_order_relaxed);
+        Bytes.fetch_add(InBytes, std::memory_order_relaxed);
+    }
+
+    void SetWriteCalls(uint64 InWriteCalls) { WriteCalls.store(InWriteCalls, std::memory_order_relaxed); }
+
+    FThroughputSnapshot Snapshot() const;
+
+    void Reset();
+
+private:
+    std::atomic<uint64> Messages;
+    std::atomic<uint64> Bytes;
+    std::atomic<uint64> WriteCalls;
+    std::atomic<uint64> StartCycles;
+};
+
+// 无锁延迟直方图（对数-线性分桶，每个2的幂区间再分8个子桶）
+// 可以在任意线程写入样本，在任意线程读取快照
+class MESSAGEMANGER_API FLatencyHistogram
+{
+public:
+    FLatencyHistogram();
+
+    // 记录一个微秒样本
+    void AddSample(uint64 Micros);
+
+    // 记录由 FPlatformTime::Cycles64() 差值表示的样本
+    void AddCycles(uint64 Cycles);
+
+    // 计算当前的 p50/p99/max
+    FLatencySnapshot Snapshot() const;
+
+    // 清空所有样本
+    void Reset();
+
+private:
+    static constexpr int32 SubBucketBits = 3;
+    static constexpr int32 SubBucketCount = 1 << SubBucketBits;
+    static constexpr int32 NumBuckets = (64 - SubBucketBits + 1) * SubBucketCount;
+
+    static int32 BucketIndex(uint64 Micros);
+    static double BucketValue(int32 Index);
+
+    std::atomic<uint64> Buckets[NumBuckets];
+    std::atomic<uint64> Count;
+    std::atomic<uint64> Max;
+};
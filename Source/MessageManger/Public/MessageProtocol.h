@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// 分片协议常量
+namespace MessageProtocol
+{
+    // 最大分片负载大小 (64KB)
+    constexpr int32 MaxChunkSize = 65536;
+
+    // 批量帧中每条消息的长度前缀大小（4字节大端序）
+    constexpr int32 BatchLengthPrefixSize = 4;
+
+    // 长度前缀的低16位是消息长度（批量帧不超过一个分片），高16位是消息类型ID
+    constexpr uint32 BatchLengthMask = 0xFFFF;
+    constexpr int32 BatchTypeIdShift = 16;
+}
+
+// 帧类型
+enum class EFrameType : uint8
+{
+    // 负载是一条消息
+    Message = 0,
+    // 负载是多条消息：重复的 [4字节大端序长度 + 消息内容]
+    Batch = 1,
+};
+
+// 分片头部结构 (发送端与接收端共用，按主机字节序直接写入)
+// 4字节消息ID + 4字节总长度 + 4字节分片索引 + 1字节是否最后分片 + 1字节帧类型 + 2字节消息类型ID
+struct FChunkHeader
+{
+    uint32 MessageId = 0;
+    uint32 TotalLength = 0;
+    uint32 ChunkIndex = 0;
+    uint8 IsLastChunk = 0;
+    EFrameType FrameType = EFrameType::Message;
+    // 单条消息帧的消息类型ID（FMessageTypeRegistry），批量帧和旧版本对端为0
+    uint16 MessageTypeId = 0;
+
+    // 根据总长度和分片索引计算本分片负载大小，非法头部（包括总长度超过MaxTotalLength）返回 INDEX_NONE
+    int32 GetPayloadSize(uint32 MaxTotalLength = MAX_int32) const
+    {
+        const uint64 ChunkOffset = (uint64)ChunkIndex * MessageProtocol::MaxChunkSize;
+        if (TotalLength > FMath::Min<uint32>(MaxTotalLength, MAX_int32) || ChunkOffset >= TotalLength)
+        {
+            return INDEX_NONE;
+        }
+        return (int32)FMath::Min<uint64>(MessageProtocol::MaxChunkSize, TotalLength - ChunkOffset);
+    }
+
+    // 消息的总分片数
+    int32 GetTotalChunks() const
+    {
+        return (int32)(((uint64)TotalLength + MessageProtocol::MaxChunkSize - 1) / MessageProtocol::MaxChunkSize);
+    }
+};
+static_assert(sizeof(FChunkHeader) == 16, "FChunkHeader wire size must stay 16 bytes");
+
+namespace MessageProtocol
+{
+    constexpr int32 HeaderSize = sizeof(FChunkHeader);
+}
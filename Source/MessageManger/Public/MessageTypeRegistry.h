@@ -0,0 +1,146 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MessageBuffer.h"
+#include <atomic>
+
+// 消息类型ID：类型名UTF-8字节的FNV-1a哈希折叠为16位，0保留表示未知类型
+// 字符串字面量可以在编译期求值，收发双方不需要协商
+// 不同类型名可能哈希到同一个ID（几百个类型时就很可能出现）。本地注册的类型名之间的冲突在Register时报告；
+// 对端发来的、本地从未注册的类型与本地类型冲突时：
+// - 接收线程在解码前只看ID，冲突的消息会通过（被订阅的ID）或被丢弃（SetMessageTypeDropped的ID）
+// - 通过的消息在分发前比较类型名，名字不同时不交给该类型的订阅者，也不会被当作心跳，只交给全量回调
+class MESSAGEMANGER_API FMessageTypeRegistry
+{
+public:
+    // 未知类型（旧版本对端或批量帧头部）
+    static constexpr uint16 InvalidId = 0;
+
+    // 编译期计算字面量类型名的ID
+    template <int32 N>
+    static constexpr uint16 MakeId(const ANSICHAR (&Name)[N])
+    {
+        uint32 Hash = FnvOffsetBasis;
+        for (int32 Index = 0; Index < N - 1; ++Index)
+        {
+            Hash = (Hash ^ (uint8)Name[Index]) * FnvPrime;
+        }
+        return FoldHash(Hash);
+    }
+
+    // 运行时计算类型名的ID（按UTF-8字节，与字面量版本结果一致）
+    static uint16 MakeId(FStringView Name);
+    static uint16 MakeId(FUtf8StringView Name);
+
+    FMessageTypeRegistry();
+
+    // 注册类型名，返回稠密索引（从0开始）；已注册时返回原索引，与其他类型名的ID冲突时返回INDEX_NONE
+    int32 Register(const FString& Name);
+
+    // ID对应的稠密索引，未注册时返回INDEX_NONE（数组查找）
+    int32 FindIndex(uint16 Id) const
+    {
+        return IdToIndex[Id] - 1;
+    }
+
+    // ID对应的类型名，未注册时返回nullptr
+    const FString* FindName(uint16 Id) const
+    {
+        const int32 Index = FindIndex(Id);
+        return Index != INDEX_NONE ? &Names[Index] : nullptr;
+    }
+
+    // 稠密索引对应的类型名
+    const FString& GetName(int32 Index) const { return Names[Index]; }
+
+    // 稠密索引对应的类型名是否就是Name（区分大小写）
+    // ID相同但名字不同时，说明对端的某个类型与本地注册的类型哈希冲突
+    bool IsName(int32 Index, FStringView Name) const
+    {
+        return FStringView(Names[Index]).Equals(Name, ESearchCase::CaseSensitive);
+    }
+    bool IsName(int32 Index, FUtf8StringView Name) const
+    {
+        const TArray<UTF8CHAR>& Utf8Name = Utf8Names[Index];
+        return Utf8Name.Num() == Name.Len() && FMemory::Memcmp(Utf8Name.GetData(), Name.GetData(), Name.Len()) == 0;
+    }
+
+    // 已注册的类型数
+    int32 Num() const { return Names.Num(); }
+
+private:
+    static constexpr uint32 FnvOffsetBasis = 2166136261u;
+    static constexpr uint32 FnvPrime = 16777619u;
+
+    static constexpr uint16 FoldHash(uint32 Hash)
+    {
+        const uint16 Id = (uint16)(Hash ^ (Hash >> 16));
+        return Id == InvalidId ? 1 : Id;
+    }
+
+    // ID -> 稠密索引+1，0表示未注册
+    TArray<uint16> IdToIndex;
+
+    // 稠密索引 -> 类型名
+    TArray<FString> Names;
+
+    // 稠密索引 -> UTF-8类型名，与解码前的类型名比较时不转换字符串
+    TArray<TArray<UTF8CHAR>> Utf8Names;
+};
+
+// 内置消息类型的ID
+namespace MessageTypeIds
+{
+    constexpr uint16 Heartbeat = FMessageTypeRegistry::MakeId("Heartbeat");
+
+    // 类型ID相同且类型名就是Heartbeat时才是心跳，与心跳ID冲突的其他类型按普通消息处理
+    inline bool IsHeartbeat(uint16 TypeId, FUtf8StringView Type)
+    {
+        return TypeId == Heartbeat && Type.Len() == 9 && FMemory::Memcmp(Type.GetData(), "Heartbeat", 9) == 0;
+    }
+    inline bool IsHeartbeat(uint16 TypeId, FStringView Type)
+    {
+        return TypeId == Heartbeat && Type.Equals(TEXT("Heartbeat"), ESearchCase::CaseSensitive);
+    }
+}
+
+// 消息类型ID的集合（位图），游戏线程修改，接收线程在解码之前查询
+class FMessageTypeSet
+{
+public:
+    FMessageTypeSet()
+    {
+        for (std::atomic<uint64>& Word : Bits)
+        {
+            Word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Set(uint16 Id, bool bContains)
+    {
+        const uint64 Bit = 1ull << (Id & 63);
+        if (bContains)
+        {
+            Bits[Id >> 6].fetch_or(Bit, std::memory_order_relaxed);
+        }
+        else
+        {
+            Bits[Id >> 6].fetch_and(~Bit, std::memory_order_relaxed);
+        }
+    }
+
+    bool Contains(uint16 Id) const
+    {
+        return (Bits[Id >> 6].load(std::memory_order_relaxed) >> (Id & 63)) & 1;
+    }
+
+private:
+    std::atomic<uint64> Bits[65536 / 64];
+};
+
+// 带类型ID的一条消息负载
+struct FTypedMessagePayload
+{
+    FMessagePayloadView Payload;
+    uint16 TypeId = FMessageTypeRegistry::InvalidId;
+};
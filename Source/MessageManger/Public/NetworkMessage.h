@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "NetworkMessage.generated.h"
+
+// 消息发送优先级，数值越小越优先
+// 大消息按64KB分片发送，高优先级的消息可以插在低优先级消息的两个分片之间
+UENUM(BlueprintType)
+enum class ENetworkMessagePriority : uint8
+{
+    // 控制消息（心跳等），总是最先发送
+    Control,
+    // 交互消息（输入、状态同步等）
+    Interactive,
+    // 大块数据（快照、资源等）
+    Bulk,
+
+    Count UMETA(Hidden)
+};
+
+// 消息编码方式，收发双方需要一致
+UENUM(BlueprintType)
+enum class ENetworkMessageCodec : uint8
+{
+    // {"Type":..., "Data":...} JSON文本
+    Json,
+    // protobuf-lite信封（Proto/NetworkEnvelope.proto）
+    Protobuf,
+    // 与Json相同，但Data作为JSON值直接嵌入，不转义为字符串；JsonData不是合法JSON时退回字符串
+    JsonRawData,
+};
+
+// 消息结构体
+USTRUCT(BlueprintType)
+struct FNetworkMessage
+{
+    GENERATED_BODY()
+
+    UPROPERTY(BlueprintReadWrite, Category = "Network")
+    FString MessageType;
+    
+    UPROPERTY(BlueprintReadWrite, Category = "Network")
+    FString JsonData;
+
+    // 发送优先级，只影响本地发送顺序，不写入消息内容
+    UPROPERTY(BlueprintReadWrite, Category = "Network")
+    ENetworkMessagePriority Priority = ENetworkMessagePriority::Interactive;
+
+    // 发送序号，由发送线程按连接从1递增填写（只有protobuf信封会传输）
+    UPROPERTY(BlueprintReadOnly, Category = "Network")
+    int64 Sequence = 0;
+
+    // 创建时间（UTC Unix微秒），SendMessage时为0则自动填写（只有protobuf信封会传输）
+    UPROPERTY(BlueprintReadWrite, Category = "Network")
+    int64 CreatedUnixMicros = 0;
+
+    // 编码发送的时间（UTC Unix微秒），由发送线程填写（只有protobuf信封会传输）
+    UPROPERTY(BlueprintReadOnly, Category = "Network")
+    int64 SentUnixMicros = 0;
+
+    // RPC关联ID，请求和对应的响应相同，0表示不是RPC消息（由CallRemote填写）
+    UPROPERTY(BlueprintReadOnly, Category = "Network")
+    int64 CorrelationId = 0;
+
+    // 是否是RPC响应
+    UPROPERTY(BlueprintReadOnly, Category = "Network")
+    bool bIsResponse = false;
+    
+    FNetworkMessage() {}
+    FNetworkMessage(const FString& InType, const FString& InData, ENetworkMessagePriority InPriority = ENetworkMessagePriority::Interactive) 
+        : MessageType(InType), JsonData(InData), Priority(InPriority) {}
+
+    // 当前UTC时间（Unix微秒）
+    static int64 GetUtcNowUnixMicros()
+    {
+        return (FDateTime::UtcNow().GetTicks() - FDateTime(1970, 1, 1).GetTicks()) / ETimespan::TicksPerMicrosecond;
+    }
+};
+
+// 发送队列溢出策略
+UENUM(BlueprintType)
+enum class ESendQueueOverflowPolicy : uint8
+{
+    // 阻塞调用者直到队列有空间或超时
+    Block,
+    // 丢弃队列中最旧的消息（先从低优先级通道丢弃，不会为低优先级的新消息丢弃高优先级的消息）
+    DropOldest,
+    // 丢弃新消息
+    DropNewest,
+    // 立即返回失败
+    FailFast,
+};
+
+// 消息订阅者在哪个线程上执行
+UENUM(BlueprintType)
+enum class EMessageHandlerThread : uint8
+{
+    // 游戏线程，在收件箱Tick中按预算分发
+    GameThread,
+    // 接收线程，解码后立即调用，会阻塞后续消息的接收
+    ReceiveThread,
+    // UE::Tasks工作线程；同一类型的消息经过同一个管道（FPipe），按到达顺序逐条执行，不会并发，
+    // 不同类型的订阅者之间可以并发
+    TaskWorker,
+};
@@ -0,0 +1,23 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "NetworkMessage.h"
+
+// FNetworkMessage的protobuf-lite信封编解码，字段定义见 Proto/NetworkEnvelope.proto
+// 直接使用WireFormatLite读写线格式，不依赖protoc生成的代码
+// 只在附带protobuf库的平台上可用（WITH_PROTOBUF），其他平台Connect拒绝使用Protobuf编码
+class MESSAGEMANGER_API FProtobufEnvelopeCodec
+{
+public:
+    // 当前平台是否链接了protobuf-lite和upb
+    static constexpr bool IsAvailable() { return WITH_PROTOBUF != 0; }
+
+    // 编码消息并追加到OutBytes末尾
+    static void Encode(const FNetworkMessage& Message, TArray<uint8>& OutBytes);
+
+    // 解码一个信封，格式错误时返回false
+    static bool Decode(const uint8* Data, int32 Length, FNetworkMessage& OutMessage);
+
+    // 在信封中找到负载字段（JsonData的UTF-8字节），不转换字符串；格式错误时返回false，没有负载时OutLength为0
+    static bool FindPayload(const uint8* Data, int32 Length, const uint8*& OutPayload, int32& OutLength);
+};
@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/CriticalSection.h"
+#include "NetworkMessage.h"
+#include <atomic>
+
+// RPC调用结果
+enum class ERpcStatus : uint8
+{
+    // 收到响应
+    Ok,
+    // 超过截止时间没有收到响应
+    Timeout,
+    // 连接断开或未连接
+    Disconnected,
+    // 请求没有进入发送队列
+    SendFailed,
+    // 未完成的调用数达到上限
+    TooManyCalls,
+};
+
+struct FRpcResult
+{
+    ERpcStatus Status = ERpcStatus::Ok;
+
+    // 响应消息，只在Status为Ok时有效
+    FNetworkMessage Response;
+
+    bool IsOk() const { return Status == ERpcStatus::Ok; }
+};
+
+// 不经过TFuture等待RPC结果的接收者（例如协程的awaiter），完成时不需要额外的堆分配
+class FRpcWaiter
+{
+public:
+    virtual ~FRpcWaiter() = default;
+
+    // 调用完成时在完成它的线程上调用一次
+    virtual void OnRpcComplete(FRpcResult&& Result) = 0;
+};
+
+// 未完成RPC调用的槽位数组
+// 关联ID的低IndexBits位是槽位下标+1，其上32位是槽位的代数，查找不需要哈希；
+// 槽位复用后代数加一，超时后才到达的旧响应不会匹配到新的调用。ID始终小于2^53，JSON中可以用double精确表示
+// 任意线程可以添加和完成调用，所有操作持锁的时间都是O(1)，只有检查截止时间时遍历槽位
+class MESSAGEMANGER_API FRpcCallTable
+{
+public:
+    static constexpr int32 IndexBits = 20;
+    static constexpr int32 MaxCapacity = (1 << IndexBits) - 1;
+
+    FRpcCallTable();
+
+    // 最多同时未完成的调用数，不超过MaxCapacity
+    void SetCapacity(int32 InCapacity);
+
+    // 分配一个槽位，返回关联ID，已满时返回0
+    uint64 Add(uint64 DeadlineCycles, TFuture<FRpcResult>& OutFuture);
+
+    // 分配一个槽位，完成时调用Waiter（Waiter需要保持有效直到完成），已满时返回0
+    uint64 Add(uint64 DeadlineCycles, FRpcWaiter& Waiter);
+
+    // 用结果完成一个调用，ID不存在（已超时或已完成）时返回false
+    // Promise或Waiter在锁外完成，Then的回调在调用线程上执行
+    bool Complete(uint64 CorrelationId, FRpcResult&& Result);
+
+    // 超过截止时间的调用以Timeout完成，返回完成的调用数
+    int32 ExpireDeadlines(uint64 NowCycles);
+
+    // 所有未完成的调用以Status完成
+    void FailAll(ERpcStatus Status);
+
+    // 未完成的调用数（任意线程）
+    int32 Num() const { return NumPending.load(std::memory_order_relaxed); }
+
+private:
+    // 调用完成时通知的对象，二者只有一个有效
+    struct FCompletion
+    {
+        TOptional<TPromise<FRpcResult>> Promise;
+        FRpcWaiter* Waiter = nullptr;
+
+        bool IsSet() const { return Promise.IsSet() || Waiter != nullptr; }
+        void SetResult(FRpcResult&& Result);
+    };
+
+    struct FSlot
+    {
+        FCompletion Completion;
+        uint64 DeadlineCycles = 0;
+        uint32 Generation = 0;
+    };
+
+    static constexpr uint64 IndexMask = (1ull << IndexBits) - 1;
+
+    // 分配槽位，返回下标，已满时返回INDEX_NONE（调用时持有锁）
+    int32 AllocateLocked(uint64 DeadlineCycles);
+
+    // 槽位下标对应的关联ID（调用时持有锁）
+    uint64 MakeCorrelationIdLocked(int32 Index) const;
+
+    // 释放槽位并取出完成对象（调用时持有锁）
+    FCompletion ReleaseLocked(int32 Index);
+
+    mutable FCriticalSection Lock;
+    TArray<FSlot> Slots;
+    TArray<int32> FreeSlots;
+    int32 Capacity;
+
+    // 最早的截止时间，没有到达时ExpireDeadlines不遍历槽位
+    uint64 EarliestDeadline;
+
+    std::atomic<int32> NumPending;
+};
@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Deque.h"
+#include "HAL/CriticalSection.h"
+#include "NetworkMessage.h"
+#include <atomic>
+
+class FEvent;
+
+// 发送队列中的消息，附带入队时间用于统计延迟
+struct FQueuedMessage
+{
+    FNetworkMessage Message;
+    uint64 EnqueueCycles = 0;
+
+    // 估算的内存占用，用于字节上限
+    int64 SizeBytes = 0;
+};
+
+// 按消息数和字节数限长的发送队列
+// 多个生产者线程入队，发送线程出队；超过高水位和回落到低水位时各通知一次
+// 每个优先级一条通道，出队时总是先取优先级最高的通道，同一通道内先进先出
+class MESSAGEMANGER_API FSendQueue
+{
+public:
+    // 优先级通道数
+    static constexpr int32 NumLanes = (int32)ENetworkMessagePriority::Count;
+
+    // 消息所在的通道
+    static int32 GetLane(const FNetworkMessage& Message) { return FMath::Clamp((int32)Message.Priority, 0, NumLanes - 1); }
+
+    // 队列限制
+    struct FLimits
+    {
+        // 最大消息数，0表示不限
+        int32 MaxMessages = 0;
+        // 最大字节数，0表示不限
+        int64 MaxBytes = 0;
+        // 高水位（占上限的比例）
+        float HighWatermark = 0.8f;
+        // 低水位（占上限的比例）
+        float LowWatermark = 0.5f;
+        // 溢出策略
+        ESendQueueOverflowPolicy OverflowPolicy = ESendQueueOverflowPolicy::FailFast;
+        // Block策略下最多阻塞的毫秒数
+        uint32 BlockTimeoutMs = 50;
+    };
+
+    // 入队结果
+    enum class EEnqueueResult : uint8
+    {
+        // 已入队
+        Queued,
+        // 已入队，并丢弃了最旧的消息
+        QueuedDroppedOldest,
+        // 队列已满，新消息被丢弃（DropNewest，或DropOldest时只剩更高优先级的消息可丢）
+        DroppedNewest,
+        // 队列已满，新消息被拒绝（FailFast或Block超时）
+        Rejected,
+        // 队列已关闭
+        Closed,
+    };
+
+    // 水位变化回调，参数为true表示超过高水位，false表示回落到低水位；在入队/出队线程上调用，不持有锁
+    using FWatermarkCallback = TFunction<void(bool bAboveHighWatermark)>;
+
+    FSendQueue();
+    ~FSendQueue();
+
+    // 设置限制，在没有生产者和消费者时调用
+    void SetLimits(const FLimits& InLimits) { Limits = InLimits; }
+
+    // 设置水位变化回调
+    void SetWatermarkCallback(FWatermarkCallback InCallback) { WatermarkCallback = MoveTemp(InCallback); }
+
+    // 入队，bOutWasEmpty表示入队前队列为空（需要唤醒发送线程）
+    EEnqueueResult Enqueue(FQueuedMessage&& Message, bool& bOutWasEmpty);
+
+    // 从通道[0, LaneLimit)中取出优先级最高的消息，这些通道都为空时返回false
+    bool Dequeue(FQueuedMessage& OutMessage, int32 LaneLimit = NumLanes);
+
+    // 重新打开队列
+    void Open();
+
+    // 关闭队列并唤醒阻塞的生产者
+    void Close();
+
+    // 清空队列
+    void Reset();
+
+    int32 Num() const;
+    int64 NumBytes() const;
+
+    // 因溢出丢弃或拒绝的消息总数
+    uint64 GetDroppedCount() const { return DroppedCount.load(std::memory_order_relaxed); }
+
+private:
+    // 按当前策略判断是否已满（调用时持有锁）
+    bool IsFull(int64 IncomingBytes) const;
+
+    // 检查水位变化（调用时持有锁），返回需要通知的状态
+    bool UpdateWatermark(bool& bOutAboveHigh);
+
+    // 移除通道的队首（调用时持有锁）
+    void PopFirstLocked(int32 Lane, FQueuedMessage* OutMessage);
+
+    // DropOldest策略：从不比新消息优先的通道中丢弃最旧的消息（调用时持有锁），没有可丢弃的消息时返回false
+    bool DropOldestLocked(int32 IncomingLane);
+
+    mutable FCriticalSection Lock;
+    TDeque<FQueuedMessage> Lanes[NumLanes];
+    int32 QueuedMessages;
+    int64 QueuedBytes;
+    bool bClosed;
+    bool bAboveHighWatermark;
+
+    FLimits Limits;
+    FWatermarkCallback WatermarkCallback;
+
+    // Block策略下等待空间的生产者
+    FEvent* SpaceAvailableEvent;
+    std::atomic<int32> BlockedProducers;
+
+    std::atomic<uint64> DroppedCount;
+};
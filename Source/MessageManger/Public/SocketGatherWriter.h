@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MessageProtocol.h"
+#include "MessageBuffer.h"
+
+class FSocket;
+
+// 分片聚合写入器
+// 分片头部和负载切片作为独立的iovec交给内核（sendmsg），不经过中间缓冲区
+// 不支持sendmsg的平台退化为复用的暂存缓冲区 + 每批一次Send
+// Linux上负载较大的批次可选使用MSG_ZEROCOPY，负载引用保留到内核完成通知
+// 内核发送缓冲区已满时保留未写出的部分（待发送输出），Socket可写后从断点继续
+class MESSAGEMANGER_API FSocketGatherWriter
+{
+public:
+    // 写出结果
+    enum class EFlushResult : uint8
+    {
+        // 所有分片已交给内核
+        Complete,
+        // 内核发送缓冲区已满，剩余数据保留在写入器中，等待Socket可写后继续
+        WouldBlock,
+        // Socket出错
+        Error,
+    };
+
+    // InZeroCopyThreshold: 批次负载不小于该字节数时使用MSG_ZEROCOPY，0表示关闭
+    FSocketGatherWriter(FSocket& InSocket, int32 InZeroCopyThreshold);
+    ~FSocketGatherWriter();
+
+    // 追加一个分片，头部复制到写入器内部，负载只保存引用
+    void AddChunk(const FChunkHeader& Header, const FMessageBufferRef& Payload, int32 Offset, int32 Size);
+
+    // 将已追加的分片尽可能写入Socket，部分写入时从断点继续
+    EFlushResult Flush();
+
+    // 已追加但尚未写出的字节数
+    int32 GetPendingBytes() const { return PendingBytes - SentBytes; }
+
+    // 已追加但尚未写出的分片数
+    int32 GetPendingChunks() const { return Chunks.Num() - FirstUnsentChunk; }
+
+    // 一次写系统调用最多写出的分片数（每个分片占头部和负载两个iovec）
+    static int32 GetMaxChunksPerWrite();
+
+    // 是否有尚未写出的数据
+    bool HasPendingOutput() const { return Chunks.Num() > 0; }
+
+    // 累计的写系统调用次数
+    uint64 GetWriteCalls() const { return WriteCalls; }
+
+private:
+    // 一个待写出的分片
+    struct FChunkSegment
+    {
+        int32 HeaderIndex;
+        const uint8* Payload;
+        int32 PayloadSize;
+    };
+
+    // 回收已完成的零拷贝发送
+    void ReapZeroCopyCompletions();
+
+    // 使用sendmsg写出所有分片
+    EFlushResult FlushGather(bool bZeroCopy);
+
+    // 退化路径：打包到暂存缓冲区后一次Send
+    EFlushResult FlushStaged();
+
+    // 清空已写出的分片
+    void ResetBatch();
+
+    FSocket& Socket;
+
+    // 本批次的分片头部
+    TArray<FChunkHeader> Headers;
+
+    // 本批次的分片
+    TArray<FChunkSegment> Chunks;
+
+    // 本批次引用的负载缓冲区，写出完成前保持存活
+    TArray<FMessageBufferRef> HeldPayloads;
+
+    // 本批次的负载字节数
+    int32 PendingPayloadBytes;
+
+    // 本批次的总字节数（头部 + 负载）
+    int32 PendingBytes;
+
+    // 本批次已写出的字节数
+    int32 SentBytes;
+
+    // 第一个未写完的分片，以及该分片（头部 + 负载）内已写出的字节数
+    int32 FirstUnsentChunk;
+    int32 FirstUnsentOffset;
+
+    // 退化路径的暂存缓冲区
+    TArray<uint8> StagingBuffer;
+
+    // 暂存缓冲区已写出的字节数，以及其中包含的最后一个分片之后的索引
+    int32 StagedOffset;
+    int32 StagedChunkEnd;
+
+    int32 ZeroCopyThreshold;
+
+    // 等待内核完成通知的零拷贝发送
+    struct FZeroCopyPending
+    {
+        uint32 Sequence;
+        TArray<FChunkHeader> Headers;
+        TArray<FMessageBufferRef> Payloads;
+    };
+    TArray<FZeroCopyPending> ZeroCopyPending;
+
+    // 下一次零拷贝发送的内核序号
+    uint32 NextZeroCopySequence;
+
+    // 本批次使用零拷贝的sendmsg调用次数
+    uint32 ZeroCopyCallsInBatch;
+
+    // 累计的写系统调用次数
+    uint64 WriteCalls;
+
+    // 原生Socket句柄，不可用时为-1
+    int32 NativeSocket;
+};
@@ -1,32 +1,193 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/Ticker.h"
 #include "Subsystems/GameInstanceSubsystem.h"
-#include "Async/AsyncWork.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/World.h"
 #include "Runtime/Networking/Public/Networking.h"
 #include "Runtime/Json/Public/Serialization/JsonSerializer.h"
+#include "MessageMangerStats.h"
+#include "JsonOnDemand.h"
+#include "DecodePipeline.h"
+#include "MessageBuffer.h"
+#include "MessageInbox.h"
+#include "MessageProtocol.h"
+#include "MessageTypeRegistry.h"
+#include "NetworkMessage.h"
+#include "RpcCallTable.h"
+#include "SendQueue.h"
+#include "Tasks/Pipe.h"
+#include "UpbEnvelopeDecoder.h"
 #include "TCPCommunicationSubsystem.generated.h"
 
-// 消息结构体
+// 连接参数，在Connect之前设置，下次连接生效
 USTRUCT(BlueprintType)
-struct FNetworkMessage
+struct FTCPConnectionSettings
 {
     GENERATED_BODY()
 
-    UPROPERTY(BlueprintReadWrite, Category = "Network")
-    FString MessageType;
-    
-    UPROPERTY(BlueprintReadWrite, Category = "Network")
-    FString JsonData;
-    
-    FNetworkMessage() {}
-    FNetworkMessage(const FString& InType, const FString& InData) 
-        : MessageType(InType), JsonData(InData) {}
+    // 批次负载不小于该字节数时在Linux上使用MSG_ZEROCOPY发送，0表示关闭
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 ZeroCopyThreshold = 0;
+
+    // 合并发送：多条消息的分片累积后一次写出
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bCoalesceSends = false;
+
+    // 合并发送时累积到该字节数立即写出
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 CoalesceByteThreshold = 16 * 1024;
+
+    // 多分片消息每次写出的字节数（不小于CoalesceByteThreshold，最多IOV_MAX/2个分片），两次写出之间检查更高优先级的消息
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 LargeFrameWriteBytes = 256 * 1024;
+
+    // 合并发送时第一条未写出消息最多等待的微秒数；发送线程按毫秒挂起，不足1毫秒的剩余时间向上取整
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 CoalesceWindowMicros = 500;
+
+    // 合并发送时在每帧结束时自动调用FlushSends
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bFlushSendsAtEndOfFrame = true;
+
+    // 将小消息打包为批量帧发送（对端需支持批量帧）
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bEnableBatchFrames = false;
+
+    // 不超过该字节数的消息进入批量帧
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 BatchMessageMaxSize = 1024;
+
+    // 接收端允许的最大帧负载（字节），分片头部声明的总长度超过时视为字节流损坏并断开，不按该长度分配内存
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 MaxMessageSize = 64 * 1024 * 1024;
+
+    // 收发线程的栈大小（字节），0表示使用平台默认值
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 IoThreadStackSize = 128 * 1024;
+
+    // 收发线程的优先级（EThreadPriority未反射，只能在C++中设置）
+    EThreadPriority IoThreadPriority = TPri_AboveNormal;
+
+    // 统计接收线程的唤醒延迟（数据到达内核到线程被唤醒），每次唤醒多一次peek系统调用；目前只有Linux支持
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bMeasureReceiveWakeLatency = false;
+
+    // 消息编码方式，服务端需要使用相同的编码
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    ENetworkMessageCodec MessageCodec = ENetworkMessageCodec::Json;
+
+    // Protobuf编码时在接收线程用upb解码，临时arena建在栈上，解码后立即释放，字符串字段引用接收缓冲区
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bUpbArenaDecode = false;
+
+    // 发送队列最多容纳的消息数，0表示不限
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 SendQueueMaxMessages = 65536;
+
+    // 发送队列最多占用的字节数（按消息字符串估算），0表示不限
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int64 SendQueueMaxBytes = 64 * 1024 * 1024;
+
+    // 发送队列高水位（占上限的比例），超过时通知一次
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    float SendQueueHighWatermark = 0.8f;
+
+    // 发送队列低水位（占上限的比例），超过高水位后回落到该值时通知一次
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    float SendQueueLowWatermark = 0.5f;
+
+    // 发送队列满时的处理方式
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    ESendQueueOverflowPolicy SendQueueOverflowPolicy = ESendQueueOverflowPolicy::FailFast;
+
+    // Block策略下SendMessage最多阻塞的毫秒数（会阻塞调用线程，包括游戏线程）
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 SendQueueBlockTimeoutMs = 50;
+
+    // 在哪个TickGroup分发收到的消息
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    TEnumAsByte<ETickingGroup> InboxTickGroup = TG_PrePhysics;
+
+    // 每帧分发收到的消息最多占用的毫秒数，超出的消息留到下一帧，0表示不限
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    float InboxBudgetMs = 2.0f;
+
+    // 在UE::Tasks工作线程上并行解码交给游戏线程的消息，结果按到达顺序交付（upb解码模式下不使用）
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    bool bParallelDecode = false;
+
+    // 并行解码时不小于该字节数的消息才交给工作线程，更小的消息仍在游戏线程解码
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 ParallelDecodeMinBytes = 4096;
+
+    // 最多同时未完成的RPC调用数
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    int32 RpcMaxInFlight = 4096;
+
+    // CallRemote没有指定超时时间时使用的秒数
+    UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Network|TCP")
+    float RpcTimeoutSeconds = 5.0f;
+};
+
+class UTCPCommunicationSubsystem;
+
+// 每帧分发收件箱中消息的Tick函数
+USTRUCT()
+struct FTCPInboxTickFunction : public FTickFunction
+{
+    GENERATED_BODY()
+
+    UTCPCommunicationSubsystem* Subsystem = nullptr;
+
+    virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+    virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FTCPInboxTickFunction> : public TStructOpsTypeTraitsBase2<FTCPInboxTickFunction>
+{
+    enum
+    {
+        WithCopy = false
+    };
 };
 
 // 消息处理委托
 DECLARE_DELEGATE_OneParam(FOnMessageReceived, const FNetworkMessage&);
+// 按消息类型订阅的多播委托
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnTypedMessageReceived, const FNetworkMessage&);
 DECLARE_DELEGATE_OneParam(FOnConnectionStatusChanged, bool /*bConnected*/);
+// 原始消息字节处理委托（只读视图，不复制数据）
+DECLARE_DELEGATE_OneParam(FOnMessagePayloadReceived, const FMessagePayloadView& /*Payload*/);
+// 信封处理委托（upb解码模式），字段直接引用接收缓冲区，只在回调期间有效
+DECLARE_DELEGATE_OneParam(FOnEnvelopeReceived, const FNetworkEnvelopeView& /*Envelope*/);
+// JSON消息处理委托（JSON编码），根值直接读取接收缓冲区，只在回调期间有效；
+// 需要保留某个值时用Payload.Slice(Value.GetOffset(), Value.GetRawJson().Len())，不复制数据
+DECLARE_DELEGATE_TwoParams(FOnJsonMessageReceived, const FMessagePayloadView& /*Payload*/, const FJsonOnDemandValue& /*Root*/);
+// 发送队列水位变化委托，true表示超过高水位，false表示回落到低水位
+DECLARE_DELEGATE_OneParam(FOnSendQueueWatermark, bool /*bAboveHighWatermark*/);
+
+// 在接收线程或任务线程上执行的订阅者
+struct FWorkerMessageSubscriber
+{
+    FDelegateHandle Handle;
+    FOnMessageReceived Handler;
+    EMessageHandlerThread Thread = EMessageHandlerThread::ReceiveThread;
+
+    // 订阅的类型名，解码后与消息的类型名比较，排除ID冲突的其他类型
+    FString Type;
+};
+
+// 类型ID -> 非游戏线程订阅者，每次订阅或退订都复制一份新表，接收线程只读
+using FWorkerSubscriberTable = TMap<uint16, TArray<FWorkerMessageSubscriber>>;
+
+// 类型ID -> 合并键字段名（UTF-8），每次设置都复制一份新表，接收线程只读
+using FCoalesceKeyFieldTable = TMap<uint16, TArray<UTF8CHAR>>;
 
 UCLASS()
 class MESSAGEMANGER_API UTCPCommunicationSubsystem : public UGameInstanceSubsystem
@@ -46,16 +207,107 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Network|TCP")
     void Disconnect();
 
-    // 发送消息
+    // 发送消息，未连接、队列已关闭或队列已满而没有入队（FailFast、Block超时、DropNewest丢弃新消息）时返回false
     UFUNCTION(BlueprintCallable, Category = "Network|TCP")
     bool SendMessage(const FNetworkMessage& Message);
 
-    // 注册消息处理回调
+    // 发起RPC调用：为请求分配关联ID后发送，对端以相同关联ID回复的响应（bIsResponse）完成返回的Future
+    // 可以同时有多个调用未完成（最多RpcMaxInFlight个）；响应在游戏线程分发收件箱时完成，不会交给消息回调，
+    // 不要在游戏线程上等待Future，用Then处理结果。TimeoutSeconds不大于0时使用RpcTimeoutSeconds；
+    // ResponseType为空时响应类型与请求相同，接收线程据此放行响应
+    TFuture<FRpcResult> CallRemote(const FNetworkMessage& Request, float TimeoutSeconds = 0.0f, const FString& ResponseType = FString());
+
+    // 同上，结果交给Waiter（Waiter需要保持有效直到完成），不分配TFuture；未连接等立即失败时在本函数内完成
+    void CallRemote(const FNetworkMessage& Request, FRpcWaiter& Waiter, float TimeoutSeconds = 0.0f, const FString& ResponseType = FString());
+
+    // 回复对端发起的RPC请求
+    bool SendResponse(const FNetworkMessage& Request, const FNetworkMessage& Response);
+
+    // 未完成的RPC调用数
+    int32 GetPendingRpcCount() const { return RpcCalls.Num(); }
+
+    // 立即写出合并窗口中累积的消息（游戏线程在帧末调用）
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    void FlushSends();
+
+    // 设置连接参数
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    void SetConnectionSettings(const FTCPConnectionSettings& InSettings) { Settings = InSettings; }
+
+    // 获取连接参数
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    const FTCPConnectionSettings& GetConnectionSettings() const { return Settings; }
+
+    // 注册消息处理回调（接收所有类型，会让接收线程无法按订阅过滤）
     void RegisterMessageHandler(FOnMessageReceived InHandler);
+
+    // 订阅一种消息类型，同一类型可以有多个订阅者；类型ID冲突时返回无效句柄
+    // 没有订阅者（也没有全量回调）的类型在接收线程丢弃，不解码
+    // Thread不是GameThread时回调必须线程安全且不能访问UObject，需要对端在头部填写类型ID；
+    // TaskWorker订阅者对同一类型的消息按到达顺序串行执行；RPC响应只交给等待的调用，不交给这些订阅者；
+    // 退订后已经开始的调用仍可能执行完
+    FDelegateHandle SubscribeToMessageType(const FString& Type, FOnMessageReceived Handler, EMessageHandlerThread Thread = EMessageHandlerThread::GameThread);
+
+    // 按句柄退订
+    bool UnsubscribeFromMessageType(FDelegateHandle Handle);
     
+    // 注册原始消息字节回调，在反序列化之前以只读视图调用
+    void RegisterMessagePayloadHandler(FOnMessagePayloadReceived InHandler);
+
+    // 注册信封回调，只在upb解码模式下调用，不需要FString时比消息回调少一次字符串转换
+    void RegisterEnvelopeHandler(FOnEnvelopeReceived InHandler);
+
+    // 注册JSON消息回调，只在JSON编码下调用，按需读取字段，不构造FNetworkMessage
+    void RegisterJsonMessageHandler(FOnJsonMessageReceived InHandler);
+
     // 注册连接状态变化回调
     void RegisterConnectionStatusHandler(FOnConnectionStatusChanged InHandler);
 
+    // 注册发送队列水位变化回调（在游戏线程中执行）
+    void RegisterSendQueueWatermarkHandler(FOnSendQueueWatermark InHandler);
+
+    // 注册消息类型名，返回稠密索引；与已注册类型的ID冲突时返回INDEX_NONE并输出错误
+    int32 RegisterMessageType(const FString& Type);
+
+    // 已注册的消息类型
+    const FMessageTypeRegistry& GetMessageTypeRegistry() const { return MessageTypes; }
+
+    // 在接收线程按类型ID丢弃该类型的消息，不复制、不重组、不解码（需要对端在头部填写类型ID）
+    // 类型名会注册到类型表，与已注册类型ID冲突时不丢弃并输出错误；与对端其他类型的冲突无法检测，
+    // ID相同的其他类型也会在解码前被丢弃
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    void SetMessageTypeDropped(const FString& Type, bool bDropped);
+
+    // 游戏线程收件箱对该类型只保留每个键最新的一条等待分发的消息，用于高频的位置、属性等状态消息
+    // KeyField为消息体（Data）中的字段名，例如实体ID，值相同的消息互相替换；为空时整个类型只保留最新一条
+    // 消息体中没有该字段的消息不合并。非游戏线程订阅者仍然收到每一条消息；RPC使用的类型不要合并
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    void SetMessageTypeCoalesced(const FString& Type, bool bCoalesced, const FString& KeyField = TEXT(""));
+
+    // 收件箱中被同一个键的新消息替换掉的消息总数
+    uint64 GetInboxCoalescedCount() const { return Inbox.GetCoalescedCount(); }
+
+    // 接收线程是否需要接收该类型的消息（游戏线程或其他线程上有人处理）
+    // 只按ID判断，ID冲突的其他类型也会通过，分发前再比较类型名
+    bool IsMessageTypeWanted(uint16 TypeId) const;
+
+    // 接收线程是否需要把该类型的消息交给游戏线程
+    bool IsMessageTypeWantedOnGameThread(uint16 TypeId) const;
+
+    // 发送队列中的消息数
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    int32 GetSendQueueDepth() const { return SendQueue.Num(); }
+
+    // 因发送队列溢出被丢弃或拒绝的消息总数
+    uint64 GetSendQueueDroppedCount() const { return SendQueue.GetDroppedCount(); }
+
+    // 收件箱中等待游戏线程分发的消息数
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    int32 GetInboxDepth() const { return Inbox.Num(); }
+
+    // 在时间预算内分发收件箱中的消息（收件箱Tick函数调用）
+    void DrainInbox();
+
     // 检查是否连接
     UFUNCTION(BlueprintCallable, Category = "Network|TCP")
     bool IsConnected() const { return bIsConnected; }
@@ -65,33 +317,210 @@ public:
     
     // 反序列化JSON为消息
     bool DeserializeMessage(const FString& JsonString, FNetworkMessage& OutMessage);
+
+    // 按指定编码将消息编码为线上字节（替换OutBytes的内容）
+    void EncodeMessage(const FNetworkMessage& Message, ENetworkMessageCodec Codec, TArray<uint8>& OutBytes);
+
+    // 按指定编码从线上字节解码消息
+    bool DecodeMessage(const uint8* Data, int32 Length, ENetworkMessageCodec Codec, FNetworkMessage& OutMessage);
+
+    // 用示例消息对比各编码方式的线上字节数和每条消息的编解码CPU时间，返回报告文本
+    UFUNCTION(BlueprintCallable, Category = "Network|TCP")
+    FString BenchmarkCodecs(const FNetworkMessage& Sample, int32 Iterations = 10000);
     
-    // 处理接收到的原始数据
-    void ProcessReceivedData(const TArray<uint8>& Data);
+    // 处理接收到的一条完整消息，TypeId来自分片头部
+    void ProcessReceivedData(FMessagePayloadView Payload, uint16 TypeId);
+
+    // 处理接收到的批量帧，原地切分为多条消息
+    void ProcessReceivedBatch(FMessagePayloadView Batch);
+
+    // upb解码模式：在接收线程解码帧中的信封后交给游戏线程
+    void ProcessReceivedEnvelopes(EFrameType FrameType, FMessagePayloadView Frame, uint16 TypeId);
 
     // 广播消息
 	void BroadcastMessage(const FNetworkMessage& Message);
+
+    // 接收线程处理延迟：Socket::Wait返回到该消息交给收件箱或订阅者，包括读取、重组和接收线程上的解码；
+    // 不包括数据到达内核到线程被唤醒的时间
+    FLatencySnapshot GetReceiveProcessLatency() const { return ReceiveProcessLatency.Snapshot(); }
+
+    // 接收线程唤醒延迟：内核收到每次唤醒时最早的未读数据到Socket::Wait返回（需要bMeasureReceiveWakeLatency，目前只有Linux）
+    FLatencySnapshot GetReceiveWakeLatency() const { return ReceiveWakeLatency.Snapshot(); }
+
+    // 发送延迟（SendMessage入队到首个分片交给send()）
+    FLatencySnapshot GetSendLatency() const { return SendLatency.Snapshot(); }
+
+    // 发送吞吐量（消息数、字节数、写系统调用次数）
+    FThroughputSnapshot GetSendThroughput() const { return SendThroughput.Snapshot(); }
+
+    // 发送端编码开销（当前连接的编码方式）
+    FCodecSnapshot GetEncodeStats() const { return EncodeStats.Snapshot(); }
+
+    // 接收端解码开销（当前连接的编码方式）
+    FCodecSnapshot GetDecodeStats() const { return DecodeStats.Snapshot(); }
 private:
+    friend class FReceiveWorker;
+    friend class FSendWorker;
+
     // TCP套接字
     TSharedPtr<FSocket> Socket;
     
     // 连接状态
     bool bIsConnected;
+
+    // 连接参数
+    FTCPConnectionSettings Settings;
+
+    // 当前连接使用的编码方式（连接时从Settings复制）
+    ENetworkMessageCodec ActiveCodec;
     
     // 消息接收线程
-    FAsyncTask<class FReceiveWorker>* ReceiveTask;
+    class FReceiveWorker* ReceiveWorker;
+    FRunnableThread* ReceiveThread;
     
-    // 消息发送队列
-    TQueue<FNetworkMessage, EQueueMode::Mpsc> SendQueue;
+    // 消息发送队列（有界）
+    FSendQueue SendQueue;
+
+    // 接收线程交给游戏线程的消息
+    FMessageInbox Inbox;
+
+    // 并行解码并按序号重排后放入收件箱
+    FOrderedDecodePipeline DecodePipeline{ Inbox };
+
+    // 当前连接是否并行解码（连接时从Settings复制）
+    bool bActiveParallelDecode = false;
+
+    // 在工作线程上解码一条收件箱消息
+    void DecodeInboxEntry(FInboxEntry& Entry);
+
+    // 每帧分发收件箱的Tick函数
+    FTCPInboxTickFunction InboxTickFunction;
+
+    // 收件箱Tick函数注册到的World（子系统跨地图存在，Tick函数随关卡销毁）
+    TWeakObjectPtr<UWorld> InboxTickWorld;
+
+    // 按当前参数把收件箱Tick函数注册到World的持久关卡
+    void RegisterInboxTick(UWorld* World);
+
+    // 本游戏实例的新World初始化后重新注册收件箱Tick
+    void HandlePostWorldInitialization(UWorld* World, const UWorld::InitializationValues IVS);
+    FDelegateHandle PostWorldInitializationHandle;
+
+    // 注册了收件箱Tick的World清理时注销
+    void HandleWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+    FDelegateHandle WorldCleanupHandle;
+
+    // 没有World注册收件箱Tick时（连接早于World创建、地图切换期间）由核心Ticker分发，收件箱不会无限增长
+    bool DrainInboxWithoutWorld(float DeltaTime);
+
+    // 收件箱后备分发的Ticker句柄
+    FTSTicker::FDelegateHandle InboxFallbackTickerHandle;
+
+    // 发送线程唤醒事件
+    FEvent* SendEvent;
+
+    // 游戏线程请求立即写出合并窗口
+    std::atomic<bool> bFlushRequested;
+
+    // 帧末自动写出的委托句柄
+    FDelegateHandle EndFrameHandle;
     
     // 消息发送线程
-    FAsyncTask<class FSendWorker>* SendTask;
+    class FSendWorker* SendWorker;
+    FRunnableThread* SendThread;
     
+    // 消息类型注册表（游戏线程）
+    FMessageTypeRegistry MessageTypes;
+
+    // 被丢弃的类型ID（接收线程查询）
+    FMessageTypeSet DroppedMessageTypes;
+
+    // 在收件箱中合并的类型ID（接收线程查询）
+    FMessageTypeSet CoalescedMessageTypes;
+
+    // 合并类型的键字段名的当前快照，只在交换指针时加锁
+    TSharedPtr<const FCoalesceKeyFieldTable, ESPMode::ThreadSafe> CoalesceKeyFields;
+    mutable FRWLock CoalesceKeyFieldsLock;
+
+    // 在接收线程取出合并键，该类型不合并或消息体中没有键字段时返回false
+    bool GetCoalesceKey(const FInboxEntry& Entry, uint64& OutKey) const;
+
+    // 取合并键时解析嵌套负载复用的文档和转义暂存区（只在接收线程使用）
+    mutable FJsonOnDemandDocument CoalesceKeyDocument;
+    mutable TArray<uint8> CoalesceKeyScratch;
+
+    // 有游戏线程订阅者的类型ID（接收线程查询）
+    FMessageTypeSet SubscribedMessageTypes;
+
+    // 有非游戏线程订阅者的类型ID（接收线程查询）
+    FMessageTypeSet WorkerMessageTypes;
+
+    // 未完成的RPC调用
+    FRpcCallTable RpcCalls;
+
+    // RPC响应可能使用的类型ID（接收线程查询），发起过调用的类型一直保留
+    FMessageTypeSet RpcResponseTypes;
+
+    // 用响应完成对应的RPC调用
+    void CompleteRpcCall(const FNetworkMessage& Response);
+
+    // 超过截止时间的RPC调用以Timeout完成（核心Ticker每帧在游戏线程调用，不依赖World和收件箱Tick）
+    bool ExpireRpcDeadlines(float DeltaTime);
+
+    // RPC超时检查的Ticker句柄
+    FTSTicker::FDelegateHandle RpcDeadlineTickerHandle;
+
+    // 超时秒数对应的截止时间（FPlatformTime::Cycles64）
+    uint64 GetRpcDeadlineCycles(float TimeoutSeconds) const;
+
+    // 为已分配关联ID的请求放行响应类型并发送
+    void SendRpcRequest(const FNetworkMessage& Request, uint64 CorrelationId, const FString& ResponseType);
+
+    // 非游戏线程订阅者的当前快照，只在交换指针时加锁
+    TSharedPtr<const FWorkerSubscriberTable, ESPMode::ThreadSafe> WorkerSubscribers;
+    mutable FRWLock WorkerSubscribersLock;
+
+    // 非游戏线程订阅句柄 -> 类型ID
+    TMap<FDelegateHandle, uint16> WorkerSubscriptionTypeIds;
+
+    // 每种类型一个任务管道，同一类型的TaskWorker订阅者按到达顺序串行执行（只在接收线程访问，断开时等待清空）
+    TMap<uint16, TUniquePtr<UE::Tasks::FPipe>> WorkerTaskPipes;
+
+    // 复制当前订阅者快照，修改后替换（游戏线程调用）
+    void UpdateWorkerSubscribers(TFunctionRef<void(FWorkerSubscriberTable&)> Update);
+
+    // 在接收线程上把消息交给该类型的非游戏线程订阅者，Decode只在有订阅者时调用
+    void DispatchToWorkerSubscribers(uint16 TypeId, TFunctionRef<bool(FNetworkMessage&)> Decode);
+
+    // 按类型稠密索引存放的订阅者
+    TIndirectArray<FOnTypedMessageReceived> TypeSubscribers;
+
+    // 订阅句柄 -> 类型稠密索引
+    TMap<FDelegateHandle, int32> SubscriptionTypeIndices;
+
+    // 是否注册了接收所有类型的回调（接收线程查询）
+    std::atomic<bool> bHasCatchAllHandlers{ false };
+
     // 消息处理回调
     FOnMessageReceived MessageReceivedDelegate;
+
+    // 原始消息字节回调
+    FOnMessagePayloadReceived MessagePayloadDelegate;
+
+    // 信封回调
+    FOnEnvelopeReceived EnvelopeReceivedDelegate;
+
+    // JSON消息回调
+    FOnJsonMessageReceived JsonMessageDelegate;
+
+    // 游戏线程解析JSON消息复用的文档
+    FJsonOnDemandDocument JsonDocument;
     
     // 连接状态变化回调
     FOnConnectionStatusChanged ConnectionStatusDelegate;
+
+    // 发送队列水位变化回调
+    FOnSendQueueWatermark SendQueueWatermarkDelegate;
     
     // 心跳定时器
     FTimerHandle HeartbeatTimer;
@@ -111,56 +540,107 @@ private:
     // 处理接收到的心跳包
     void HandleHeartbeat();
     
-    // 粘包处理缓冲区
-    TArray<uint8> ReceiveBuffer;
-    
+    // 接收线程处理延迟统计
+    FLatencyHistogram ReceiveProcessLatency;
+
+    // 接收线程唤醒延迟统计
+    FLatencyHistogram ReceiveWakeLatency;
+
+    // 发送延迟统计
+    FLatencyHistogram SendLatency;
+
+    // 发送吞吐量统计
+    FThroughputCounter SendThroughput;
+
+    // 编解码开销统计
+    FCodecCounter EncodeStats;
+    FCodecCounter DecodeStats;
+
     // 通知连接状态变化
     void NotifyConnectionStatusChanged(bool bNewConnected);
+
+    // 在游戏线程上分发一条消息
+    void DispatchPayload(const FMessagePayloadView& Payload, uint16 TypeId, const FDecodedPayload* Decoded = nullptr);
+
+    // 在游戏线程上分发一条JSON消息，心跳不转换字符串；Decoded不为空时使用工作线程解析好的文档
+    void DispatchJsonPayload(const FMessagePayloadView& Payload, uint16 TypeId, const FDecodedPayload* Decoded);
+
+    // 有订阅者的类型ID对应的稠密索引，没有时返回INDEX_NONE（数组查找，不比较类型名）
+    int32 FindSubscribedTypeIndex(uint16 TypeId) const;
+
+    // 该类型的订阅者，没有时返回nullptr
+    // 类型名与订阅时的名字不同（对端的类型与本地类型ID冲突）时不交给订阅者，并输出一次警告
+    FOnTypedMessageReceived* FindTypeSubscribers(uint16 TypeId, FUtf8StringView Type);
+    FOnTypedMessageReceived* FindTypeSubscribers(uint16 TypeId, FStringView Type);
+
+    // 每个类型ID只报告一次冲突
+    void ReportTypeCollision(uint16 TypeId, int32 TypeIndex, const FString& Type);
+
+    // 已经报告过ID冲突的类型ID（游戏线程）
+    TSet<uint16> ReportedTypeCollisions;
+
+    // 将消息交给类型订阅者和全量消息回调
+    void DeliverMessage(const FNetworkMessage& NetworkMessage, FOnTypedMessageReceived* Subscribers);
+
+    // 注册或清除全量回调后更新bHasCatchAllHandlers
+    void UpdateCatchAllHandlers();
+
+    // 从JSON根值读取Type和Data
+    static bool ReadJsonMessage(const FJsonOnDemandValue& Root, FNetworkMessage& OutMessage);
+
+    // 在游戏线程上分发一条已解码的信封
+    void DispatchEnvelope(const FNetworkEnvelopeView& Envelope);
+
+    // 将批量帧切分为同一缓冲区上的多条消息，格式错误时返回false
+    static bool SplitBatchFrame(const FMessagePayloadView& Batch, TArray<FTypedMessagePayload>& OutMessages);
 };
 
-// 接收消息的异步任务
-class FReceiveWorker : public FNonAbandonableTask
+// 接收消息的专用线程
+class FReceiveWorker : public FRunnable
 {
 public:
     FReceiveWorker(UTCPCommunicationSubsystem* InSubsystem, TSharedPtr<FSocket> InSocket)
-        : Subsystem(InSubsystem), Socket(InSocket) {}
-
-    ~FReceiveWorker() {}
+        : Subsystem(InSubsystem), Socket(InSocket), Settings(InSubsystem->Settings), bStopRequested(false) {}
 
-    // 执行任务
-    void DoWork();
-
-    // 获得当前任务的统计信息
-    FORCEINLINE TStatId GetStatId() const
-    {
-        RETURN_QUICK_DECLARE_CYCLE_STAT(FReceiveWorker, STATGROUP_ThreadPoolAsyncTasks);
-    }
+    // FRunnable
+    virtual uint32 Run() override;
+    virtual void Stop() override { bStopRequested = true; }
 
 private:
     UTCPCommunicationSubsystem* Subsystem;
     TSharedPtr<FSocket> Socket;
+
+    // 连接时的参数副本
+    FTCPConnectionSettings Settings;
+
+    // 请求线程退出
+    std::atomic<bool> bStopRequested;
 };
 
-// 发送消息的异步任务
-class FSendWorker : public FNonAbandonableTask
+// 发送消息的专用线程
+class FSendWorker : public FRunnable
 {
 public:
-    FSendWorker(UTCPCommunicationSubsystem* InSubsystem, TSharedPtr<FSocket> InSocket, TQueue<FNetworkMessage, EQueueMode::Mpsc>& InSendQueue)
-        : Subsystem(InSubsystem), Socket(InSocket), SendQueue(InSendQueue) {}
+    FSendWorker(UTCPCommunicationSubsystem* InSubsystem, TSharedPtr<FSocket> InSocket, FSendQueue& InSendQueue, FEvent* InSendEvent)
+        : Subsystem(InSubsystem), Socket(InSocket), SendQueue(InSendQueue), SendEvent(InSendEvent), Settings(InSubsystem->Settings), bStopRequested(false) {}
 
-    ~FSendWorker() {}
-
-    // 执行任务
-    void DoWork();
-
-    // 获得当前任务的统计信息
-    FORCEINLINE TStatId GetStatId() const
+    // FRunnable
+    virtual uint32 Run() override;
+    virtual void Stop() override
     {
-        RETURN_QUICK_DECLARE_CYCLE_STAT(FSendWorker, STATGROUP_ThreadPoolAsyncTasks);
+        bStopRequested = true;
+        SendEvent->Trigger();
     }
 
 private:
     UTCPCommunicationSubsystem* Subsystem;
     TSharedPtr<FSocket> Socket;
-    TQueue<FNetworkMessage, EQueueMode::Mpsc>& SendQueue;
+    FSendQueue& SendQueue;
+    FEvent* SendEvent;
+
+    // 连接时的参数副本
+    FTCPConnectionSettings Settings;
+
+    // 请求线程退出
+    std::atomic<bool> bStopRequested;
 };
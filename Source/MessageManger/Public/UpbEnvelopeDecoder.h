@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MessageBuffer.h"
+#include "NetworkMessage.h"
+
+// 解码后的protobuf信封，字符串字段直接引用接收缓冲区，不复制数据
+struct FNetworkEnvelopeView
+{
+    // 整条信封的原始字节
+    FMessagePayloadView Source;
+
+    // 消息类型（UTF-8，指向Source的缓冲区）
+    FUtf8StringView Type;
+
+    // 负载字节（FNetworkMessage::JsonData的UTF-8字节，Source的子视图）
+    FMessagePayloadView Payload;
+
+    int64 Sequence = 0;
+    int64 CreatedUnixMicros = 0;
+    int64 SentUnixMicros = 0;
+    int64 CorrelationId = 0;
+    bool bIsResponse = false;
+
+    // 转为FNetworkMessage（会转换并复制字符串）
+    FNetworkMessage ToMessage() const;
+};
+
+// 用upb解码protobuf信封
+// 每次解码在栈上的一块内存中建立临时arena，字段读出到FNetworkEnvelopeView后立即释放，
+// 字符串字段引用接收缓冲区，解码过程中没有堆分配
+class MESSAGEMANGER_API FUpbEnvelopeDecoder
+{
+public:
+    // 解码一条信封，格式错误时返回false
+    static bool Decode(const FMessagePayloadView& Source, FNetworkEnvelopeView& OutEnvelope);
+};
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// UTF-16与UTF-8互转
+// ASCII段每次处理16个字符（x86用SSE2，ARM64用NEON），其余字符逐个码点转换
+// 所有接口都按长度处理，不要求也不写入结尾的'\0'
+class MESSAGEMANGER_API FUtf8Transcoder
+{
+public:
+    // UTF-16长度为Length时UTF-8结果的最大字节数
+    static constexpr int32 MaxUtf8Bytes(int32 Utf16Length) { return Utf16Length * 3; }
+
+    // UTF-8长度为Length时UTF-16结果的最大码元数
+    static constexpr int32 MaxUtf16Units(int32 Utf8Length) { return Utf8Length; }
+
+    // UTF-16转UTF-8，Dest至少需要MaxUtf8Bytes(Length)字节，返回写入的字节数
+    // 不成对的代理项写为U+FFFD
+    static int32 Utf16ToUtf8(const UTF16CHAR* Source, int32 Length, uint8* Dest);
+
+    // 已验证的UTF-8转UTF-16，Dest至少需要MaxUtf16Units(Length)个码元，返回写入的码元数
+    // 输入必须先通过IsValidUtf8
+    static int32 Utf8ToUtf16(const uint8* Source, int32 Length, UTF16CHAR* Dest);
+
+    // 验证UTF-8，有utf8_range的平台（WITH_UTF8_RANGE）使用utf8_range，其他平台使用标量实现
+    static bool IsValidUtf8(const uint8* Data, int32 Length);
+
+    // 将一个码点编码为UTF-8，Dest至少需要4字节，返回写入的字节数
+    static int32 EncodeCodePoint(uint32 CodePoint, uint8* Dest);
+};
@@ -12,6 +12,8 @@ public class ProtobufLibrary : ModuleRules
 		PublicSystemIncludePaths.Add("$(ModuleDir)/include");
         PublicDefinitions.Add("PROTOBUF_ENABLE_DEBUG_LOGGING_MAY_LEAK_PII=0");
         PublicDefinitions.Add("PROTOBUF_BUILTIN_ATOMIC=0");
+        // ֻWin64Ԥ⣬ƽ̨MessageMangerʹprotobuf/upbutf8_range
+        bool bHasPrebuiltLibraries = false;
         if (Target.Platform == UnrealTargetPlatform.Win64)
 		{
             // // Add the import library
@@ -31,6 +33,17 @@ public class ProtobufLibrary : ModuleRules
                 {
                     Console.WriteLine("Loading lib file: {0}", libFile);
                     PublicAdditionalLibraries.Add(libFile);
+                    bHasPrebuiltLibraries = true;
+                }
+            }
+
+            // ӦDLLƵִļԱߣʱϵͳҵ
+            string binFolder = Path.Combine(ModuleDirectory, "bin");
+            if (Directory.Exists(binFolder))
+            {
+                foreach (string dllFile in Directory.GetFiles(binFolder, "*.dll"))
+                {
+                    RuntimeDependencies.Add(Path.Combine("$(TargetOutputDir)", Path.GetFileName(dllFile)), dllFile);
                 }
             }
         }
@@ -47,6 +60,9 @@ public class ProtobufLibrary : ModuleRules
 			// RuntimeDependencies.Add(ExampleSoPath);
 		}
 
+        PublicDefinitions.Add("WITH_PROTOBUF=" + (bHasPrebuiltLibraries ? "1" : "0"));
+        PublicDefinitions.Add("WITH_UTF8_RANGE=" + (bHasPrebuiltLibraries ? "1" : "0"));
+
         /**
 		*ϲʱUE4IProtobufҪã
 		*ʵעЩҲܱͨ
@@ -7,9 +7,31 @@ import json
 
 # 定义头部结构体格式 (匹配FChunkHeader)
 # 4字节MessageId(uint32) + 4字节TotalLength(uint32) + 4字节ChunkIndex(uint32) + 1字节IsLastChunk(uint8)
+# + 1字节FrameType(uint8) + 2字节MessageTypeId(uint16)
 # 使用小端字节序('<')匹配多数系统
-HEADER_FORMAT = '<IIII'
-HEADER_SIZE = struct.calcsize(HEADER_FORMAT)  # 13字节
+HEADER_FORMAT = '<IIIBBH'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)  # 16字节
+
+# 最大分片负载大小，与客户端MessageProtocol::MaxChunkSize一致
+MAX_CHUNK_SIZE = 65536
+
+# 帧类型
+FRAME_TYPE_MESSAGE = 0
+FRAME_TYPE_BATCH = 1
+
+# 批量帧长度前缀：低16位为长度，高16位为消息类型ID
+BATCH_LENGTH_MASK = 0xFFFF
+BATCH_TYPE_ID_SHIFT = 16
+
+
+def message_type_id(type_name):
+    """与FMessageTypeRegistry::MakeId一致：类型名UTF-8字节的FNV-1a哈希折叠为16位，0保留"""
+    value = 2166136261
+    for byte in type_name.encode('utf-8'):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    type_id = (value ^ (value >> 16)) & 0xFFFF
+    return type_id or 1
+
 
 class FragmentedMessageServer:
     def __init__(self, host='0.0.0.0', port=12345):
@@ -92,7 +114,7 @@ class FragmentedMessageServer:
                 
                 # 解析头部
                 try:
-                    message_id, total_length, chunk_index, is_last_chunk = struct.unpack(
+                    message_id, total_length, chunk_index, is_last_chunk, frame_type, type_id = struct.unpack(
                         HEADER_FORMAT, header_data)
                     
                     # 检查退出命令
@@ -106,20 +128,18 @@ class FragmentedMessageServer:
                           f"收到分片 - MessageId: {message_id}, "
                           f"总长度: {total_length}, "
                           f"分片索引: {chunk_index}, "
+                          f"类型ID: {type_id}, "
                           f"是否最后分片: {'是' if is_last_chunk else '否'}")
                     
                 except struct.error as e:
                     print(f"解析头部失败: {e}")
                     continue
                 
-                # 2. 接收消息体
-                if is_last_chunk:
-                    # 最后一个分片：计算剩余长度
-                    received_length = sum(len(data) for data in self.fragment_cache[message_id].values())
-                    body_length = total_length - received_length
-                else:
-                    # 非最后一个分片：使用默认缓冲区大小
-                    body_length = 1024  # 可根据实际情况调整
+                # 2. 接收消息体，长度由总长度和分片索引决定
+                body_length = min(MAX_CHUNK_SIZE, total_length - chunk_index * MAX_CHUNK_SIZE)
+                if body_length <= 0:
+                    print(f"非法分片索引 {chunk_index} (总长度 {total_length})")
+                    return
                 
                 # 接收消息体
                 body_data = b''
@@ -138,7 +158,7 @@ class FragmentedMessageServer:
                 
                 # 4. 检查是否是最后一个分片，如果是则尝试合并消息
                 if is_last_chunk:
-                    self.try_assemble_message(message_id, client_address, client_socket)
+                    self.try_assemble_message(message_id, frame_type, client_address, client_socket)
                 
         except Exception as e:
             print(f"处理客户端 {client_address} 时出错: {e}")
@@ -147,7 +167,7 @@ class FragmentedMessageServer:
             if client_socket in self.clients:
                 self.clients.remove(client_socket)
 
-    def try_assemble_message(self, message_id, client_address, client_socket):
+    def try_assemble_message(self, message_id, frame_type, client_address, client_socket):
         """尝试合并所有分片为完整消息，并回复确认"""
         try:
             chunks = self.fragment_cache.get(message_id, {})
@@ -183,28 +203,14 @@ class FragmentedMessageServer:
             print(f"\n===== 消息 {message_id} 合并完成 =====")
             print(f"总长度: {len(full_message)} 字节")
             print(f"分片数量: {len(chunks)} 个")
-            
-            # 尝试解析为字符串
-            try:
-                message_str = full_message.decode('utf-8')
-                print(f"解析为字符串: {message_str}")
-                
-                # 收到消息后自动回复（核心修改点：被动回复逻辑）
-                response = json.dumps({
-                    "Type": "Heartbeat",
-                    "Data": "12312312",
-                    "Timestamp": datetime.now().strftime('%Y-%m-%d %H:%M:%S')
-                }, ensure_ascii=False, separators=(',', ':'))
-                self.send_fragmented_message(client_socket, response.encode('utf-8'))
-                
-            except UnicodeDecodeError:
-                print("无法解析为UTF-8字符串（可能是二进制数据）")
-                # 发送二进制消息确认
-                response = json.dumps({
-                    "Type": "BinaryResponse",
-                    "Data": f"已收到二进制消息，长度: {len(full_message)}字节"
-                }, ensure_ascii=False, separators=(',', ':'))
-                self.send_fragmented_message(client_socket, response.encode('utf-8'))
+
+            # 批量帧：拆分为多条消息逐条处理，回复同样打包成批量帧发送
+            if frame_type == FRAME_TYPE_BATCH:
+                replies = [self.handle_message(entry) for entry in self.split_batch(full_message)]
+                self.send_batched_messages(client_socket, replies)
+            else:
+                data, type_id = self.handle_message(full_message)
+                self.send_fragmented_message(client_socket, data, type_id)
             
             print("====================================\n")
             
@@ -215,8 +221,103 @@ class FragmentedMessageServer:
         except Exception as e:
             print(f"合并消息 {message_id} 失败: {e}")
 
-    def send_fragmented_message(self, client_socket, data):
-        """按照FChunkHeader格式分块发送消息"""
+    def split_batch(self, batch):
+        """拆分批量帧：重复的 [4字节大端序(类型ID << 16 | 长度)][消息内容]"""
+        messages = []
+        offset = 0
+        while offset < len(batch):
+            if len(batch) - offset < 4:
+                print(f"批量帧长度前缀不完整 (偏移 {offset}/{len(batch)})")
+                break
+            (prefix,) = struct.unpack_from('>I', batch, offset)
+            length = prefix & BATCH_LENGTH_MASK
+            offset += 4
+            if length > len(batch) - offset:
+                print(f"批量帧条目长度 {length} 超出帧范围 (偏移 {offset}/{len(batch)})")
+                break
+            messages.append(batch[offset:offset + length])
+            offset += length
+        print(f"批量帧包含 {len(messages)} 条消息")
+        return messages
+
+    def handle_message(self, full_message):
+        """处理一条完整消息，返回回复的 (消息内容, 类型ID)"""
+        # 尝试解析为字符串
+        try:
+            message_str = full_message.decode('utf-8')
+            print(f"解析为字符串: {message_str}")
+
+            # RPC请求：以相同的类型和关联ID回复
+            request = self.try_parse_json(message_str)
+            if isinstance(request, dict) and request.get("CorrelationId") and not request.get("Response"):
+                request_type = request.get("Type", "")
+                response = json.dumps({
+                    "Type": request_type,
+                    "Data": request.get("Data", ""),
+                    "CorrelationId": request["CorrelationId"],
+                    "Response": True
+                }, ensure_ascii=False, separators=(',', ':'))
+                return response.encode('utf-8'), message_type_id(request_type)
+            
+            # 收到消息后自动回复（核心修改点：被动回复逻辑）
+            response = json.dumps({
+                "Type": "Heartbeat",
+                "Data": "12312312",
+                "Timestamp": datetime.now().strftime('%Y-%m-%d %H:%M:%S')
+            }, ensure_ascii=False, separators=(',', ':'))
+            return response.encode('utf-8'), message_type_id("Heartbeat")
+            
+        except UnicodeDecodeError:
+            print("无法解析为UTF-8字符串（可能是二进制数据）")
+            # 发送二进制消息确认
+            response = json.dumps({
+                "Type": "BinaryResponse",
+                "Data": f"已收到二进制消息，长度: {len(full_message)}字节"
+            }, ensure_ascii=False, separators=(',', ':'))
+            return response.encode('utf-8'), message_type_id("BinaryResponse")
+
+    @staticmethod
+    def try_parse_json(text):
+        """解析JSON，失败时返回None"""
+        try:
+            return json.loads(text)
+        except ValueError:
+            return None
+
+    def send_batched_messages(self, client_socket, messages):
+        """把多条 (消息内容, 类型ID) 打包成批量帧发送，每个批量帧不超过一个分片
+        超过16位长度上限的消息单独发送，批量帧中只有一条消息时也按普通消息发送"""
+        batch = []
+        batch_size = 0
+
+        def flush():
+            nonlocal batch, batch_size
+            if len(batch) == 1:
+                data, type_id = batch[0]
+                self.send_fragmented_message(client_socket, data, type_id)
+            elif batch:
+                payload = b''.join(
+                    struct.pack('>I', (type_id << BATCH_TYPE_ID_SHIFT) | len(data)) + data for data, type_id in batch)
+                print(f"打包 {len(batch)} 条回复为批量帧")
+                self.send_fragmented_message(client_socket, payload, 0, FRAME_TYPE_BATCH)
+            batch = []
+            batch_size = 0
+
+        for data, type_id in messages:
+            if not data:
+                continue
+            if len(data) > BATCH_LENGTH_MASK:
+                flush()
+                self.send_fragmented_message(client_socket, data, type_id)
+                continue
+            if batch_size + 4 + len(data) > MAX_CHUNK_SIZE:
+                flush()
+            batch.append((data, type_id))
+            batch_size += 4 + len(data)
+        flush()
+
+    def send_fragmented_message(self, client_socket, data, type_id=0, frame_type=FRAME_TYPE_MESSAGE):
+        """按照FChunkHeader格式分块发送消息，type_id为0表示不填写消息类型ID（批量帧总是0）"""
         if not data:
             return
         
@@ -224,7 +325,7 @@ class FragmentedMessageServer:
         message_id = self.next_message_id
         self.next_message_id += 1  # 递增消息ID
         total_length = len(data)
-        chunk_size = 1024  # 每个分片的大小
+        chunk_size = MAX_CHUNK_SIZE  # 每个分片的大小
         num_chunks = (total_length + chunk_size - 1) // chunk_size  # 计算总分片数
         
         print(f"\n开始分块发送消息 - MessageId: {message_id}, 总长度: {total_length}, 分片数: {num_chunks}")
@@ -244,7 +345,9 @@ class FragmentedMessageServer:
                 message_id,
                 total_length,
                 chunk_index,
-                is_last_chunk
+                is_last_chunk,
+                frame_type,
+                type_id
             )
             
             # 发送头部+数据